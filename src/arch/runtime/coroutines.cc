@@ -68,8 +68,15 @@ struct coro_globals_t {
     /* The previous context. */
     coro_t *prev_coro;
 
-    /* A list of coro_t objects that are not in use. */
+    /* Lists of coro_t objects that are not in use, one for each stack size. */
     intrusive_list_t<coro_t> free_coros;
+    intrusive_list_t<coro_t> free_small_coros;
+
+    intrusive_list_t<coro_t> *get_free_list(coro_stack_size_t stack_size) {
+        return stack_size == coro_stack_size_t::SMALL
+            ? &free_small_coros
+            : &free_coros;
+    }
 
     /* A list of coroutines that currently have protected stacks. The least recently
     used protected coroutine is always at the front of the list. */
@@ -124,6 +131,10 @@ struct coro_globals_t {
             free_coros.remove(s);
             delete s;
         }
+        while (coro_t *s = free_small_coros.head()) {
+            free_small_coros.remove(s);
+            delete s;
+        }
     }
 
 };
@@ -162,8 +173,12 @@ void coro_runtime_t::get_coroutine_counts(std::map<std::string, size_t> *dest) {
 TLS_with_init(int64_t, coro_selfname_counter, 0);
 #endif
 
-coro_t::coro_t() :
-    stack(&coro_t::run, coro_stack_size),
+coro_t::coro_t(coro_stack_size_t _stack_size) :
+    stack(&coro_t::run,
+          _stack_size == coro_stack_size_t::SMALL
+              ? SMALL_COROUTINE_STACK_SIZE
+              : coro_stack_size),
+    stack_size_(_stack_size),
     current_thread_(linux_thread_pool_t::get_thread_id()),
     notified_(false),
     waiting_(false),
@@ -193,19 +208,20 @@ coro_t::coro_t() :
 }
 
 void coro_t::return_coro_to_free_list(coro_t *coro) {
-    coro_globals_t *cglobals = TLS_get_cglobals();
+    intrusive_list_t<coro_t> *free_list =
+        TLS_get_cglobals()->get_free_list(coro->stack_size_);
     // Note that we must guarantee that `coro` is never evicted immediately. We do so
     // by checking the free list size *before* we push `coro` onto it.
     // This is important because when we call `return_coro_to_free_list` in
     // `coro_t::run`, that coroutine is still active and must not be deleted yet.
     static_assert(COROUTINE_FREE_LIST_SIZE > 0, "COROUTINE_FREE_LIST_SIZE cannot be 0");
-    if (cglobals->free_coros.size() >= COROUTINE_FREE_LIST_SIZE) {
-        coro_t *coro_to_delete = cglobals->free_coros.tail();
-        cglobals->free_coros.remove(coro_to_delete);
+    if (free_list->size() >= COROUTINE_FREE_LIST_SIZE) {
+        coro_t *coro_to_delete = free_list->tail();
+        free_list->remove(coro_to_delete);
         delete coro_to_delete;
     }
-    rassert(cglobals->free_coros.size() < COROUTINE_FREE_LIST_SIZE);
-    cglobals->free_coros.push_back(coro);
+    rassert(free_list->size() < COROUTINE_FREE_LIST_SIZE);
+    free_list->push_back(coro);
 }
 
 coro_t::~coro_t() {
@@ -514,15 +530,16 @@ bool coroutines_have_been_initialized() {
     return TLS_get_cglobals() != nullptr;
 }
 
-coro_t * coro_t::get_coro() {
+coro_t * coro_t::get_coro(coro_stack_size_t stack_size) {
     rassert(coroutines_have_been_initialized());
     coro_t *coro;
 
-    if (TLS_get_cglobals()->free_coros.size() == 0) {
-        coro = new coro_t();
+    intrusive_list_t<coro_t> *free_list = TLS_get_cglobals()->get_free_list(stack_size);
+    if (free_list->size() == 0) {
+        coro = new coro_t(stack_size);
     } else {
-        coro = TLS_get_cglobals()->free_coros.tail();
-        TLS_get_cglobals()->free_coros.remove(coro);
+        coro = free_list->tail();
+        free_list->remove(coro);
     }
 
     rassert(!coro->intrusive_list_node_t<coro_t>::in_a_list());
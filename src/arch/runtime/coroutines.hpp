@@ -43,6 +43,13 @@ struct coro_lru_entry_t : public intrusive_list_node_t<coro_lru_entry_t> {
     coro_t *coro;
 };
 
+/* Coroutines that only run a short piece of shallow code, such as the tasks of a
+`pmap()` or of a `coro_pool_t` that just forward a message, can be given a smaller stack
+with `coro_stack_size_t::SMALL`. This saves memory and page faults when there are many
+of them at a time. Don't use it for coroutines that evaluate queries, deserialize
+datums or otherwise recurse without `call_with_enough_stack()`. */
+enum class coro_stack_size_t { NORMAL, SMALL };
+
 /* A coro_t represents a fiber of execution within a thread. Create one with spawn_*(). Within a
 coroutine, call wait() to return control to the scheduler; the coroutine will be resumed when
 another fiber calls notify_*() on it.
@@ -58,14 +65,18 @@ public:
     friend bool has_n_bytes_free_stack_space(size_t);
 
     template<class callable_t>
-    static void spawn_now_dangerously(callable_t &&action) {
-        coro_t *coro = get_and_init_coro(std::forward<callable_t>(action));
+    static void spawn_now_dangerously(
+            callable_t &&action,
+            coro_stack_size_t stack_size = coro_stack_size_t::NORMAL) {
+        coro_t *coro = get_and_init_coro(std::forward<callable_t>(action), stack_size);
         coro->notify_now_deprecated();
     }
 
     template<class callable_t>
-    static coro_t *spawn_sometime(callable_t &&action) {
-        coro_t *coro = get_and_init_coro(std::forward<callable_t>(action));
+    static coro_t *spawn_sometime(
+            callable_t &&action,
+            coro_stack_size_t stack_size = coro_stack_size_t::NORMAL) {
+        coro_t *coro = get_and_init_coro(std::forward<callable_t>(action), stack_size);
         coro->notify_sometime();
         return coro;
     }
@@ -75,7 +86,8 @@ public:
     thread first, and also doesn't switch back at the end of the coro's lifetime. */
     template<class callable_t>
     static coro_t *spawn_on_thread(callable_t &&action, threadnum_t thread) {
-        coro_t *coro = get_and_init_coro(std::forward<callable_t>(action));
+        coro_t *coro = get_and_init_coro(std::forward<callable_t>(action),
+                                         coro_stack_size_t::NORMAL);
         coro->current_thread_ = thread;
         coro->notify_sometime();
         return coro;
@@ -85,8 +97,10 @@ public:
     `spawn_later_ordered()` (or `spawn_ordered()`). `spawn_later_ordered()` does not
     honor scheduler priorities. */
     template<class callable_t>
-    static coro_t *spawn_later_ordered(callable_t &&action) {
-        coro_t *coro = get_and_init_coro(std::forward<callable_t>(action));
+    static coro_t *spawn_later_ordered(
+            callable_t &&action,
+            coro_stack_size_t stack_size = coro_stack_size_t::NORMAL) {
+        coro_t *coro = get_and_init_coro(std::forward<callable_t>(action), stack_size);
         coro->notify_later_ordered();
         return coro;
     }
@@ -174,7 +188,7 @@ private:
 
     // Constructor sets up the stack, get_and_init_coro will load a function to be run
     //  at which point the coroutine can be notified
-    coro_t();
+    explicit coro_t(coro_stack_size_t _stack_size);
 
     // Generates a spawn-time backtrace and stores it into `spawn_backtrace`.
     void grab_spawn_backtrace();
@@ -185,8 +199,9 @@ private:
 
     // If this function footprint ever changes, you may need to update the parse_coroutine_info function
     template<class callable_t>
-    static coro_t *get_and_init_coro(callable_t &&action) {
-        coro_t *coro = get_coro();
+    static coro_t *get_and_init_coro(callable_t &&action,
+                                     coro_stack_size_t stack_size) {
+        coro_t *coro = get_coro(stack_size);
 #ifndef NDEBUG
         coro->parse_coroutine_type(CURRENT_FUNCTION_PRETTY);
 #endif
@@ -205,7 +220,7 @@ private:
         return coro;
     }
 
-    static coro_t *get_coro();
+    static coro_t *get_coro(coro_stack_size_t stack_size);
 
     static void return_coro_to_free_list(coro_t *coro);
 
@@ -218,6 +233,8 @@ private:
     virtual void on_thread_switch();
 
     coro_stack_t stack;
+    // Determines which free list the coroutine is returned to.
+    const coro_stack_size_t stack_size_;
 
     threadnum_t current_thread_;
 
@@ -47,7 +47,10 @@ linux_message_hub_t::~linux_message_hub_t() {
         guarantee(get_priority_msg_list(p).empty());
     }
 
-    guarantee(incoming_messages_.empty());
+    for (int i = 0; i < thread_pool_->n_threads; i++) {
+        guarantee(incoming_messages_[i].value.messages.empty());
+    }
+    guarantee(incoming_external_messages_.messages.empty());
 }
 
 void linux_message_hub_t::do_store_message(threadnum_t nthread, linux_thread_message_t *msg) {
@@ -94,15 +97,20 @@ void linux_message_hub_t::store_message_sometime(threadnum_t nthread, linux_thre
 
 
 void linux_message_hub_t::insert_external_message(linux_thread_message_t *msg) {
-    bool do_wake_up;
+    msg_list_t msgs;
+    msgs.push_back(msg);
+    deliver_messages(&incoming_external_messages_, &msgs);
+}
+
+void linux_message_hub_t::deliver_messages(incoming_queue_t *queue, msg_list_t *msgs) {
     {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        do_wake_up = !check_and_set_is_woken_up();
-        incoming_messages_.push_back(msg);
+        spinlock_acq_t acq(&queue->lock);
+        queue->messages.append_and_clear(msgs);
+        queue->has_messages.store(true);
     }
 
     // Wakey wakey eggs and bakey
-    if (do_wake_up) {
+    if (should_wake_up()) {
         event_.wakey_wakey();
     }
 }
@@ -178,12 +186,7 @@ void linux_message_hub_t::on_event(int events) {
             // Place wakey_wakey and then yield to the event processing.
             // It will wake us up again immediately, but can handle a few
             // OS events (such as timers, network messages etc.) in the meantime.
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&incoming_messages_lock_);
-                do_wake_up = !check_and_set_is_woken_up();
-            }
-            if (do_wake_up) {
+            if (should_wake_up()) {
                 event_.wakey_wakey();
             }
             break;
@@ -192,18 +195,14 @@ void linux_message_hub_t::on_event(int events) {
 }
 
 void linux_message_hub_t::sort_incoming_messages_by_priority() {
-    // We do this in two steps to release the spinlock faster.
+    // We do this in two steps to release the spinlocks faster.
     // append_and_clear is a very cheap operation, while
     // assigning each message to a different priority queue
     // is more expensive.
 
     // 1. Pull the messages
     msg_list_t new_messages;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        new_messages.append_and_clear(&incoming_messages_);
-        is_woken_up_ = false;
-    }
+    pull_incoming_messages(&new_messages);
 
     // 2. Sort the messages into their respective priority queues
     while (linux_thread_message_t *m = new_messages.head()) {
@@ -221,38 +220,46 @@ void linux_message_hub_t::sort_incoming_messages_by_priority() {
     }
 }
 
-bool linux_message_hub_t::check_and_set_is_woken_up() {
-    const bool was_woken_up = is_woken_up_;
-    is_woken_up_ = true;
-    return was_woken_up;
+void linux_message_hub_t::pull_incoming_queue(incoming_queue_t *queue,
+                                              msg_list_t *out) {
+    // Most threads don't send us anything between two wake ups, so we avoid taking
+    // their locks.
+    if (queue->has_messages.load()) {
+        spinlock_acq_t acq(&queue->lock);
+        out->append_and_clear(&queue->messages);
+        queue->has_messages.store(false);
+    }
 }
 
-// Pushes messages collected locally global lists available to all
-// threads.
+void linux_message_hub_t::pull_incoming_messages(msg_list_t *out) {
+    // This must happen before we look at the queues.  A sender that appends to a
+    // queue after we have looked at it is then guaranteed to wake us up again.
+    is_woken_up_.store(false);
+
+    for (int i = 0; i < thread_pool_->n_threads; i++) {
+        pull_incoming_queue(&incoming_messages_[i].value, out);
+    }
+    pull_incoming_queue(&incoming_external_messages_, out);
+}
+
+bool linux_message_hub_t::should_wake_up() {
+    // We only need to do a wake up if we're the first people to do a wake up.
+    return !is_woken_up_.exchange(true);
+}
+
+// Pushes messages collected locally onto the incoming queues of the
+// destination threads.
 void linux_message_hub_t::push_messages() {
     for (int i = 0; i < thread_pool_->n_threads; i++) {
-        // Append the local list for ith thread to that thread's global
-        // message list.
+        // Append the local list for ith thread to that thread's incoming
+        // queue for messages from this thread.
         thread_queue_t *queue = &queues_[i];
         if (!queue->msg_local_list.empty()) {
             // Transfer messages to the other core
-
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&thread_pool_->threads[i]->message_hub.incoming_messages_lock_);
-
-                // We only need to do a wake up if we're the first people to do a
-                // wake up.
-                do_wake_up =
-                    !thread_pool_->threads[i]->message_hub.check_and_set_is_woken_up();
-
-                thread_pool_->threads[i]->message_hub.incoming_messages_.append_and_clear(&queue->msg_local_list);
-            }
-
-            // Wakey wakey, perhaps eggs and bakey
-            if (do_wake_up) {
-                thread_pool_->threads[i]->message_hub.event_.wakey_wakey();
-            }
+            linux_message_hub_t *hub = &thread_pool_->threads[i]->message_hub;
+            hub->deliver_messages(
+                &hub->incoming_messages_[current_thread_.threadnum].value,
+                &queue->msg_local_list);
         }
     }
 }
@@ -4,10 +4,13 @@
 
 #include <pthread.h>
 
+#include <atomic>
+
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "arch/runtime/system_event.hpp"
 #include "arch/spinlock.hpp"
+#include "concurrency/cache_line_padded.hpp"
 #include "config/args.hpp"
 #include "containers/intrusive_list.hpp"
 #include "threading.hpp"
@@ -55,7 +58,7 @@ private:
     // debug mode.
     void do_store_message(threadnum_t nthread, linux_thread_message_t *msg);
 
-    // Moves messages from incoming_messages_ into the respective entries of
+    // Moves messages from the incoming queues into the respective entries of
     // priority_msg_lists, depending on the messages' priorities.
     void sort_incoming_messages_by_priority();
 
@@ -73,11 +76,37 @@ private:
         msg_list_t msg_local_list;
     } queues_[MAX_THREADS];
 
-    // Must only be used with acquired incoming_messages_lock_
-    bool check_and_set_is_woken_up();
-    bool is_woken_up_;
-    msg_list_t incoming_messages_;
-    spinlock_t incoming_messages_lock_;
+    /* Messages that other threads have sent to this thread.  There is one queue per
+    sending thread, so senders never contend with each other for a lock.  Each
+    sender only contends with us, and we only take the lock of a queue that has
+    messages in it. */
+    struct incoming_queue_t {
+        incoming_queue_t() : has_messages(false) { }
+
+        // Set while `messages` is non-empty.  Only changed with `lock` held.
+        std::atomic<bool> has_messages;
+        msg_list_t messages;
+        spinlock_t lock;
+    };
+
+    // Appends `msgs` to `queue` on this message hub and wakes up this hub's thread
+    // if necessary.  May be called from any thread.
+    void deliver_messages(incoming_queue_t *queue, msg_list_t *msgs);
+
+    // Moves the contents of all incoming queues onto `out`.
+    void pull_incoming_messages(msg_list_t *out);
+    static void pull_incoming_queue(incoming_queue_t *queue, msg_list_t *out);
+
+    // Sets `is_woken_up_` and returns true if it wasn't set already, in which case
+    // the caller must notify `event_`.  `is_woken_up_` is cleared by
+    // `pull_incoming_messages()`, before it looks at the queues, so a wake up is
+    // only skipped if the thread is going to see the new messages anyway.
+    bool should_wake_up();
+    std::atomic<bool> is_woken_up_;
+
+    cache_line_padded_t<incoming_queue_t> incoming_messages_[MAX_THREADS];
+    // For messages from the main thread, which doesn't have a message hub.
+    incoming_queue_t incoming_external_messages_;
 
     // Use `sort_incoming_messages_by_priority()` to sort incoming_messages_ into
     // these lists.
@@ -90,7 +119,7 @@ private:
     void on_event(int events);
 
     // The eventfd (or pipe-based alternative) notified after the first incoming
-    // message is put onto incoming_messages_.
+    // message is put onto one of the incoming queues.
     system_event_t event_;
 
     /* The thread that we queue messages originating from. (Recall that there is one
@@ -44,6 +44,15 @@ public:
         *skip_out = false;
     }
 
+    /* Can be overloaded to skip individual keys in the traversed range. Unlike
+    `handle_pair()`, this is called in order and before the value is loaded, so it's
+    much cheaper for traversals that are only interested in a few keys per leaf. */
+    virtual void filter_key(
+            UNUSED const btree_key_t *key,
+            bool *skip_out) {
+        *skip_out = false;
+    }
+
     // Passes a keyvalue and a callback.  waiter.wait_interruptible() must be called to
     // begin the region of "exclusive access", which only handle_pair implementation
     // can enters at a time.  (This should happen after loading the value from disk
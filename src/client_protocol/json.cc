@@ -5,6 +5,7 @@
 #include "arch/timing.hpp"
 #include "client_protocol/protocols.hpp"
 #include "concurrency/pmap.hpp"
+#include "concurrency/run_anywhere.hpp"
 #include "containers/scoped.hpp"
 #include "rapidjson/document.h"
 #include "rapidjson/stringbuffer.h"
@@ -96,11 +97,66 @@ scoped_ptr_t<ql::query_params_t> json_protocol_t::parse_query(
     return res;
 }
 
+// The JSON of a response.  Large result arrays are serialized on several threads
+// at once.  Rather than copying the pieces into one big buffer, we keep them apart
+// and splice them into the result array (at `data_offset` in `head`) while sending
+// the response, releasing each piece as soon as it has been written.
+class response_json_t {
+public:
+    response_json_t() : data_offset(0) { }
+
+    void clear() {
+        head.Clear();
+        data_offset = 0;
+        data.clear();
+    }
+
+    size_t size() const {
+        size_t res = head.GetSize();
+        size_t non_empty = 0;
+        for (const auto &chunk : data) {
+            if (chunk.GetSize() > 2) {
+                // Without the brackets, plus a comma between chunks.
+                res += chunk.GetSize() - 2 + (non_empty == 0 ? 0 : 1);
+                ++non_empty;
+            }
+        }
+        return res;
+    }
+
+    template <class callable_t>
+    void each_piece(callable_t &&cb) {
+        const size_t split = data.empty() ? head.GetSize() : data_offset;
+        cb(head.GetString(), split);
+        bool first = true;
+        for (auto &chunk : data) {
+            if (chunk.GetSize() <= 2) {
+                continue;
+            }
+            if (!first) {
+                cb(",", 1);
+            }
+            first = false;
+            cb(chunk.GetString() + 1, chunk.GetSize() - 2);
+            chunk.Clear();
+            chunk.ShrinkToFit();
+        }
+        cb(head.GetString() + split, head.GetSize() - split);
+    }
+
+    rapidjson::StringBuffer head;
+    size_t data_offset;
+    // Each of these is a JSON array.
+    std::vector<rapidjson::StringBuffer> data;
+
+private:
+    DISABLE_COPYING(response_json_t);
+};
+
 void write_response_internal(ql::response_t *response,
-                             rapidjson::StringBuffer *buffer_out,
+                             response_json_t *json_out,
                              bool throw_errors) {
-    rapidjson::Writer<rapidjson::StringBuffer> writer(*buffer_out);
-    size_t start_offset = buffer_out->GetSize();
+    rapidjson::Writer<rapidjson::StringBuffer> writer(json_out->head);
 
     try {
         writer.StartObject();
@@ -122,32 +178,33 @@ void write_response_internal(ql::response_t *response,
 
             size_t per_thread = response->data().size() / num_threads;
             pmap(num_threads, [&](int64_t m) {
-                    int32_t target_thread =
+                    int32_t first_thread =
                         (thread_offset + static_cast<int32_t>(m)) % get_num_db_threads();
-                    on_thread_t rethreader((threadnum_t(target_thread)));
-                    rapidjson::StringBuffer *thread_buffer = &buffers[m];
-                    rapidjson::Writer<rapidjson::StringBuffer>
-                        thread_writer(*thread_buffer);
-
-                    thread_writer.StartArray();
-                    size_t offset = per_thread * m;
-                    size_t end = (m == num_threads - 1) ?
-                        response->data().size() : (per_thread * (m + 1));
-
-                    for (size_t i = offset; i < end; ++i) {
-                        const size_t YIELD_INTERVAL = 2000;
-                        if ((i + 1) % YIELD_INTERVAL == 0) {
-                            coro_t::yield();
+                    // Each piece is encoded by whichever nearby thread is idle first.
+                    run_anywhere([&]() {
+                        rapidjson::StringBuffer *thread_buffer = &buffers[m];
+                        rapidjson::Writer<rapidjson::StringBuffer>
+                            thread_writer(*thread_buffer);
+
+                        thread_writer.StartArray();
+                        size_t offset = per_thread * m;
+                        size_t end = (m == num_threads - 1) ?
+                            response->data().size() : (per_thread * (m + 1));
+
+                        for (size_t i = offset; i < end; ++i) {
+                            const size_t YIELD_INTERVAL = 2000;
+                            if ((i + 1) % YIELD_INTERVAL == 0) {
+                                coro_t::yield();
+                            }
+                            response->data()[i].write_json(&thread_writer);
                         }
-                        response->data()[i].write_json(&thread_writer);
-                    }
 
-                    thread_writer.EndArray();
+                        thread_writer.EndArray();
+                    }, threadnum_t(first_thread));
                 });
 
-            for (const auto &buffer : buffers) {
-                writer.SpliceArray(buffer);
-            }
+            json_out->data_offset = json_out->head.GetSize();
+            json_out->data.swap(buffers);
         } else {
             for (const auto &item : response->data()) {
                 item.write_json(&writer);
@@ -174,46 +231,50 @@ void write_response_internal(ql::response_t *response,
         writer.EndObject();
         guarantee(writer.IsComplete());
     } catch (const ql::base_exc_t &ex) {
-        buffer_out->Pop(buffer_out->GetSize() - start_offset);
+        json_out->clear();
         response->fill_error(Response::RUNTIME_ERROR, Response::QUERY_LOGIC,
                              ex.what(), ql::backtrace_registry_t::EMPTY_BACKTRACE);
-        write_response_internal(response, buffer_out, true);
+        write_response_internal(response, json_out, true);
     } catch (const std::exception &ex) {
         if (throw_errors) {
             throw;
         }
 
-        buffer_out->Pop(buffer_out->GetSize() - start_offset);
+        json_out->clear();
         response->fill_error(Response::RUNTIME_ERROR, Response::INTERNAL,
             strprintf("Internal error in json_protocol_t::write: %s", ex.what()),
             ql::backtrace_registry_t::EMPTY_BACKTRACE);
-        write_response_internal(response, buffer_out, true);
+        write_response_internal(response, json_out, true);
     }
 }
 
 // Small wrapper - in debug mode we would rather crash than send the error back
-void json_protocol_t::write_response_to_buffer(ql::response_t *response,
-                                               rapidjson::StringBuffer *buffer_out) {
+void write_response_json(ql::response_t *response, response_json_t *json_out) {
 #ifdef NDEBUG
-    write_response_internal(response, buffer_out, false);
+    write_response_internal(response, json_out, false);
 #else
-    write_response_internal(response, buffer_out, true);
+    write_response_internal(response, json_out, true);
 #endif
 }
 
+void json_protocol_t::write_response_to_buffer(ql::response_t *response,
+                                               rapidjson::StringBuffer *buffer_out) {
+    response_json_t json;
+    write_response_json(response, &json);
+    char *out = buffer_out->Push(json.size());
+    json.each_piece([&](const char *piece, size_t size) {
+        memcpy(out, piece, size);
+        out += size;
+    });
+}
+
 void json_protocol_t::send_response(ql::response_t *response,
                                     int64_t token,
                                     tcp_conn_t *conn,
                                     signal_t *interruptor) {
-    uint32_t data_size; // filled in below
-    const size_t prefix_size = sizeof(token) + sizeof(data_size);
-
-    // Reserve space for the token and the size
-    rapidjson::StringBuffer buffer;
-    buffer.Push(prefix_size);
-
-    write_response_to_buffer(response, &buffer);
-    int64_t payload_size = buffer.GetSize() - prefix_size;
+    response_json_t json;
+    write_response_json(response, &json);
+    int64_t payload_size = json.size();
     guarantee(payload_size > 0);
 
     static_assert(std::is_same<decltype(wire_protocol_t::TOO_LARGE_RESPONSE_SIZE),
@@ -230,23 +291,25 @@ void json_protocol_t::send_response(ql::response_t *response,
     }
 
     // Fill in the token and size
-    char *mutable_buffer = buffer.GetMutableBuffer();
+    uint32_t data_size = static_cast<uint32_t>(payload_size);
 #ifdef __s390x__
     token = __builtin_bswap64(token);
-#endif
-    for (size_t i = 0; i < sizeof(token); ++i) {
-        mutable_buffer[i] = reinterpret_cast<const char *>(&token)[i];
-    }
-
-    data_size = static_cast<uint32_t>(payload_size);
-#ifdef __s390x__
     data_size = __builtin_bswap32(data_size);
 #endif
-    for (size_t i = 0; i < sizeof(data_size); ++i) {
-        mutable_buffer[i + sizeof(token)] =
-            reinterpret_cast<const char *>(&data_size)[i];
-    }
+    char prefix[sizeof(token) + sizeof(data_size)];
+    memcpy(&prefix[0], &token, sizeof(token));
+    memcpy(&prefix[sizeof(token)], &data_size, sizeof(data_size));
+    conn->write_buffered(prefix, sizeof(prefix), interruptor);
 
-    conn->write(buffer.GetString(), buffer.GetSize(), interruptor);
+    // Large pieces are written directly rather than copying them into the
+    // connection's write buffer first.
+    const size_t DIRECT_WRITE_THRESHOLD = 64 * KILOBYTE;
+    json.each_piece([&](const char *piece, size_t size) {
+        if (size >= DIRECT_WRITE_THRESHOLD) {
+            conn->write(piece, size, interruptor);
+        } else {
+            conn->write_buffered(piece, size, interruptor);
+        }
+    });
+    conn->flush_buffer(interruptor);
 }
-
@@ -198,8 +198,12 @@ query_server_t::query_server_t(rdb_context_t *_rdb_ctx,
         rdb_ctx(_rdb_ctx),
         handler(_handler),
         http_conn_cache(http_timeout_sec),
-        next_thread(0) {
+        next_thread(0),
+        thread_load(get_num_db_threads()) {
     rassert(rdb_ctx != nullptr);
+    for (size_t i = 0; i < thread_load.size(); ++i) {
+        thread_load[i].value.store(0);
+    }
     try {
         tcp_listener.init(new tcp_listener_t(local_addresses, port,
             std::bind(&query_server_t::handle_conn,
@@ -251,10 +255,41 @@ ql::datum_t read_datum(tcp_conn_t *connection, signal_t *interruptor) {
     }
 }
 
+// Counts a client connection or a running query towards the load of a thread.
+class thread_load_acq_t {
+public:
+    explicit thread_load_acq_t(std::atomic<int64_t> *_load) : load(_load) {
+        ++*load;
+    }
+    ~thread_load_acq_t() {
+        --*load;
+    }
+private:
+    std::atomic<int64_t> *load;
+    DISABLE_COPYING(thread_load_acq_t);
+};
+
+threadnum_t query_server_t::choose_thread() {
+    const int num_threads = get_num_db_threads();
+    int chosen = next_thread;
+    int64_t chosen_load = thread_load[chosen].value.load();
+    for (int i = 1; i < num_threads && chosen_load > 0; ++i) {
+        int candidate = (next_thread + i) % num_threads;
+        int64_t candidate_load = thread_load[candidate].value.load();
+        if (candidate_load < chosen_load) {
+            chosen = candidate;
+            chosen_load = candidate_load;
+        }
+    }
+    next_thread = (chosen + 1) % num_threads;
+    return threadnum_t(chosen);
+}
+
 void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
                                  auto_drainer_t::lock_t keepalive) {
-    threadnum_t chosen_thread = threadnum_t(next_thread);
-    next_thread = (next_thread + 1) % get_num_db_threads();
+    threadnum_t chosen_thread = choose_thread();
+    // The connection counts towards the load of its thread until we return.
+    thread_load_acq_t connection_load(&thread_load[chosen_thread.threadnum].value);
 
     cross_thread_signal_t ct_keepalive(keepalive.get_drain_signal(), chosen_thread);
     on_thread_t rethreader(chosen_thread);
@@ -595,6 +630,8 @@ void query_server_t::connection_loop(tcp_conn_t *conn,
                 auto_drainer_t::lock_t coro_drainer_lock(&coro_drainer);
                 wait_any_t cb_interruptor(coro_drainer_lock.get_drain_signal(),
                                           &interruptor);
+                thread_load_acq_t query_load(
+                    &thread_load[get_thread_id().threadnum].value);
                 ql::response_t response;
                 bool replied = false;
 
@@ -2,6 +2,7 @@
 #ifndef CLIENT_PROTOCOL_SERVER_HPP_
 #define CLIENT_PROTOCOL_SERVER_HPP_
 
+#include <atomic>
 #include <set>
 #include <map>
 #include <memory>
@@ -15,6 +16,7 @@
 #include "arch/runtime/runtime.hpp"
 #include "arch/timing.hpp"
 #include "concurrency/auto_drainer.hpp"
+#include "concurrency/cache_line_padded.hpp"
 #include "concurrency/cross_thread_signal.hpp"
 #include "containers/archive/archive.hpp"
 #include "containers/counted.hpp"
@@ -114,6 +116,10 @@ private:
                              const std::string &err,
                              ql::response_t *response_out);
 
+    // Returns the thread with the lowest load, starting the search at `next_thread`
+    // so that threads with the same load are used in turn.
+    threadnum_t choose_thread();
+
     // For the client driver socket
     void handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
                      auto_drainer_t::lock_t);
@@ -140,6 +146,10 @@ private:
     scoped_ptr_t<tcp_listener_t> tcp_listener;
 
     int next_thread;
+
+    // The number of client connections plus the number of running queries on each
+    // thread.  Updated by the threads themselves, and read by `choose_thread()`.
+    scoped_array_t<cache_line_padded_t<std::atomic<int64_t> > > thread_load;
 };
 
 #endif /* CLIENT_PROTOCOL_SERVER_HPP_ */
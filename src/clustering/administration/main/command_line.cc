@@ -1624,6 +1624,11 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
                                                     "before giving up, the default is "
                                                     "24 hours");
 
+    options_out->push_back(options::option_t(options::names_t("--cluster-compression"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--cluster-compression", "compress large messages to other servers, "
+             "for bandwidth-limited links between servers");
+
     return help;
 }
 
@@ -2107,6 +2112,7 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
                                 std::vector<std::string>(argv, argv + argc),
                                 join_delay_secs.value_or(0),
                                 node_reconnect_timeout_secs.value_or(cluster_defaults::reconnect_timeout),
+                                exists_option(opts, "--cluster-compression"),
                                 tls_configs);
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
@@ -2210,6 +2216,7 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
                                 std::vector<std::string>(argv, argv + argc),
                                 join_delay_secs.value_or(0),
                                 node_reconnect_timeout_secs.value_or(cluster_defaults::reconnect_timeout),
+                                exists_option(opts, "--cluster-compression"),
                                 tls_configs);
 
         bool result;
@@ -2400,6 +2407,7 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
                                 std::vector<std::string>(argv, argv + argc),
                                 join_delay_secs.value_or(0),
                                 node_reconnect_timeout_secs.value_or(cluster_defaults::reconnect_timeout),
+                                exists_option(opts, "--cluster-compression"),
                                 tls_configs);
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
@@ -119,6 +119,7 @@ public:
                  std::vector<std::string> &&_argv,
                  const int _join_delay_secs,
                  const int _node_reconnect_timeout_secs,
+                 bool _cluster_compression,
                  tls_configs_t _tls_configs) :
         joins(std::move(_joins)),
         reql_http_proxy(std::move(_reql_http_proxy)),
@@ -128,7 +129,8 @@ public:
         config_file(_config_file),
         argv(std::move(_argv)),
         join_delay_secs(_join_delay_secs),
-        node_reconnect_timeout_secs(_node_reconnect_timeout_secs)
+        node_reconnect_timeout_secs(_node_reconnect_timeout_secs),
+        cluster_compression(_cluster_compression)
     {
         tls_configs = _tls_configs;
     }
@@ -149,6 +151,7 @@ public:
     std::vector<std::string> argv;
     int join_delay_secs;
     int node_reconnect_timeout_secs;
+    bool cluster_compression;
     tls_configs_t tls_configs;
 };
 
@@ -22,6 +22,6 @@ backfill_progress_tracker_t::get_progress_trackers() {
             auto res = output.insert(std::move(pair));
             guarantee(res.second);
         }
-    });
+    }, coro_stack_size_t::SMALL);
     return output;
 }
@@ -37,11 +37,17 @@ private:
 template <class T>
 class coro_pool_t : private availability_callback_t, public home_thread_mixin_t {
 public:
-    coro_pool_t(size_t _worker_count, passive_producer_t<T> *_source, coro_pool_callback_t<T> *_callback)
+    // Pass `coro_stack_size_t::SMALL` as `_stack_size` if the callback is short and
+    // doesn't recurse deeply.
+    coro_pool_t(size_t _worker_count,
+                passive_producer_t<T> *_source,
+                coro_pool_callback_t<T> *_callback,
+                coro_stack_size_t _stack_size = coro_stack_size_t::NORMAL)
         : max_worker_count(_worker_count),
           active_worker_count(0),
           source(_source),
-          callback(_callback) {
+          callback(_callback),
+          stack_size(_stack_size) {
         rassert(max_worker_count > 0);
         on_source_availability_changed();   // Start process if necessary
         source->available->set_callback(this);
@@ -83,15 +89,17 @@ private:
         assert_thread();
         while (source->available->get() && active_worker_count < max_worker_count) {
             ++active_worker_count;
-            coro_t::spawn_sometime(std::bind(
-                &coro_pool_t::worker_run, this,
-                source->pop(), auto_drainer_t::lock_t(&coro_drain_semaphore)));
+            coro_t::spawn_sometime(
+                std::bind(&coro_pool_t::worker_run, this,
+                          source->pop(), auto_drainer_t::lock_t(&coro_drain_semaphore)),
+                stack_size);
         }
     }
 
     int max_worker_count, active_worker_count;
     passive_producer_t<T> *source;
     coro_pool_callback_t<T> *callback;
+    const coro_stack_size_t stack_size;
     auto_drainer_t coro_drain_semaphore;
 };
 
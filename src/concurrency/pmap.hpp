@@ -30,8 +30,11 @@ void spawn_pmap_runner_one_arg(value_t i, const callable_t *c, int64_t *outstand
     coro_t::spawn_now_dangerously(pmap_runner_one_arg_t<callable_t, value_t>(i, c, outstanding, to_signal));
 }
 
+// `stack_size` is passed on to `coro_t::spawn_now_dangerously()`.  Use
+// `coro_stack_size_t::SMALL` if `c` is short and doesn't recurse deeply.
 template <class callable_t>
-void pmap(int64_t begin, int64_t end, const callable_t &c) {
+void pmap(int64_t begin, int64_t end, const callable_t &c,
+          coro_stack_size_t stack_size = coro_stack_size_t::NORMAL) {
     guarantee(begin >= 0);  // We don't want `end - begin` to overflow, do we?
     guarantee(begin <= end);
     if (begin == end) {
@@ -41,7 +44,9 @@ void pmap(int64_t begin, int64_t end, const callable_t &c) {
     cond_t cond;
     int64_t outstanding = (end - begin);
     for (int64_t i = begin; i < end - 1; ++i) {
-        coro_t::spawn_now_dangerously(pmap_runner_one_arg_t<callable_t, int64_t>(i, &c, &outstanding, &cond));
+        coro_t::spawn_now_dangerously(
+            pmap_runner_one_arg_t<callable_t, int64_t>(i, &c, &outstanding, &cond),
+            stack_size);
     }
     pmap_runner_one_arg_t<callable_t, int64_t> runner(end - 1, &c, &outstanding, &cond);
     runner();
@@ -49,8 +54,9 @@ void pmap(int64_t begin, int64_t end, const callable_t &c) {
 }
 
 template <class callable_t>
-void pmap(int64_t count, const callable_t &c) {
-    pmap(0, count, c);
+void pmap(int64_t count, const callable_t &c,
+          coro_stack_size_t stack_size = coro_stack_size_t::NORMAL) {
+    pmap(0, count, c, stack_size);
 }
 
 template <class callable_t, class iterator_t>
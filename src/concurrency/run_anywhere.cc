@@ -0,0 +1,89 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "concurrency/run_anywhere.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/counted.hpp"
+
+namespace {
+
+// Shared by all offers of a job.  Only the offer that sets `claimed` first may look
+// at the job; the others can arrive after `run_anywhere()` has returned.
+class job_claim_t : public slow_atomic_countable_t<job_claim_t> {
+public:
+    job_claim_t() : claimed(false) { }
+    std::atomic<bool> claimed;
+};
+
+struct job_t {
+    job_t(const std::function<void()> *_fn, threadnum_t _home_thread)
+        : fn(_fn), home_thread(_home_thread), ran_on(_home_thread) { }
+    const std::function<void()> *fn;
+    threadnum_t home_thread;
+    threadnum_t ran_on;
+    std::exception_ptr error;
+    // Lives on `home_thread`.
+    cond_t done;
+};
+
+void run_job(job_t *job) {
+    job->ran_on = get_thread_id();
+    try {
+        (*job->fn)();
+    } catch (...) {
+        job->error = std::current_exception();
+    }
+    on_thread_t rethreader(job->home_thread);
+    job->done.pulse();
+}
+
+class job_offer_t : public thread_message_t {
+public:
+    job_offer_t(counted_t<job_claim_t> _claim, job_t *_job)
+        : claim(std::move(_claim)), job(_job) { }
+
+    void on_thread_switch() final {
+        if (!claim->claimed.exchange(true)) {
+            coro_t::spawn_sometime(std::bind(&run_job, job));
+        }
+        delete this;
+    }
+
+private:
+    counted_t<job_claim_t> claim;
+    job_t *job;
+
+    DISABLE_COPYING(job_offer_t);
+};
+
+}  // namespace
+
+threadnum_t run_anywhere(const std::function<void()> &fn,
+                         threadnum_t first_thread,
+                         int num_offers) {
+    guarantee(coro_t::self() != nullptr);
+    guarantee(num_offers > 0);
+    const int num_threads = get_num_db_threads();
+    num_offers = std::min(num_offers, num_threads);
+
+    job_t job(&fn, get_thread_id());
+    counted_t<job_claim_t> claim = make_counted<job_claim_t>();
+    for (int i = 0; i < num_offers; ++i) {
+        threadnum_t thread((first_thread.threadnum + i) % num_threads);
+        job_offer_t *offer = new job_offer_t(claim, &job);
+        if (continue_on_thread(thread, offer)) {
+            call_later_on_this_thread(offer);
+        }
+    }
+    job.done.wait_lazily_unordered();
+
+    if (job.error) {
+        std::rethrow_exception(job.error);
+    }
+    return job.ran_on;
+}
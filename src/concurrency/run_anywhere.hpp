@@ -0,0 +1,26 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_RUN_ANYWHERE_HPP_
+#define CONCURRENCY_RUN_ANYWHERE_HPP_
+
+#include <functional>
+
+#include "config/args.hpp"
+#include "threading.hpp"
+
+/* `run_anywhere()` is for CPU-bound work that isn't tied to the thread it's started
+on, such as encoding rows that have already been fetched as JSON.  Coroutines
+normally stay on their thread, and `on_thread_t` sends them to one fixed thread
+even if that thread is busy.  Instead, `run_anywhere()` offers `fn` to the
+`num_offers` db threads starting at `first_thread` (wrapping around), and the first
+of them to get to its offer runs `fn` in a new coroutine.  Busy threads get to their
+offers late, so the work ends up on whichever thread is idle.
+
+`fn` must be safe to run on any thread: it may only use objects that don't have a
+home thread, or whose home thread it switches to itself.  `run_anywhere()` blocks
+until `fn` has returned, rethrows any exception `fn` threw, and returns the thread
+`fn` ran on.  It must be called from a coroutine. */
+threadnum_t run_anywhere(const std::function<void()> &fn,
+                         threadnum_t first_thread,
+                         int num_offers = RUN_ANYWHERE_DEFAULT_OFFERS);
+
+#endif  // CONCURRENCY_RUN_ANYWHERE_HPP_
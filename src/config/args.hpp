@@ -69,6 +69,27 @@
 // Size of the buffer used to perform IO operations (in bytes).
 #define IO_BUFFER_SIZE                            (4 * KILOBYTE)
 
+// Buffers that cluster messages were serialized into are kept around for reuse by
+// later messages sent from the same thread, as long as they are no larger than
+// this, and at most this many per thread.
+#define CLUSTER_SEND_BUFFER_MAX_REUSED_SIZE       (64 * KILOBYTE)
+#define CLUSTER_SEND_BUFFER_MAX_REUSED_COUNT      16
+
+// With `--cluster-compression`, cluster messages at least this large are sent
+// compressed to servers that support it.  Compressed messages larger than the
+// maximum are rejected by the receiver.
+#define CLUSTER_COMPRESSION_MIN_MESSAGE_SIZE      (4 * KILOBYTE)
+#define CLUSTER_COMPRESSED_MESSAGE_MAX_SIZE       (1024 * MEGABYTE)
+
+// Cluster messages at least this large are sent in the bulk lane, which lets smaller
+// messages to the same peer go first (if the message handler allows reordering).
+#define CLUSTER_BULK_MESSAGE_MIN_SIZE             (64 * KILOBYTE)
+
+// Before flushing the messages buffered on a cluster connection to the network, we
+// wait this many milliseconds (or if it's zero, let other coroutines run once), so
+// that messages sent at about the same time go out with a single write.
+#define CLUSTER_FLUSH_DELAY_MS                    0
+
 // Size of the device block size (in bytes)
 #define DEVICE_BLOCK_SIZE                         512
 
@@ -150,6 +171,28 @@
 #define COROUTINE_STACK_SIZE                      131072
 #endif
 
+// Stack size of coroutines that are spawned with `coro_stack_size_t::SMALL`.
+#define SMALL_COROUTINE_STACK_SIZE                32768
+
+// Aggregations over a single shard are evaluated on up to
+// `MAX_PARALLEL_TERMINAL_THREADS` threads, which are handed batches of
+// `PARALLEL_TERMINAL_BATCH_SIZE` rows at a time.
+#define PARALLEL_TERMINAL_BATCH_SIZE              1000
+#define MAX_PARALLEL_TERMINAL_THREADS             8
+
+// `run_anywhere()` offers each job to this many threads by default.
+#define RUN_ANYWHERE_DEFAULT_OFFERS               4
+
+// An `order_by.limit.changes` feed of `n` rows keeps up to
+// min(n, `MAX_LIMIT_CHANGEFEED_RESERVE`) rows beyond the limit in memory on each
+// shard, so that rows dropping out of the limit rarely require a disk read.
+#define MAX_LIMIT_CHANGEFEED_RESERVE              1000
+
+// Once the changes queued up in the changefeed subscriptions of a server take up
+// more than about this much memory, subscriptions that allow it start squashing
+// changes to the same row instead of queueing them.
+#define CHANGEFEED_MEMORY_BUDGET                  (256 * MEGABYTE)
+
 
 /**
  * Message scheduler configuration
@@ -65,7 +65,7 @@ write_message_t::~write_message_t() {
     }
 }
 
-void write_message_t::append(const void *p, int64_t n) {
+void write_message_t::append_slow(const void *p, int64_t n) {
     while (n > 0) {
         if (buffers_.empty() || buffers_.tail()->size == write_buffer_t::DATA_SIZE) {
             buffers_.push_back(new write_buffer_t);
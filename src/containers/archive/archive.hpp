@@ -3,6 +3,7 @@
 #define CONTAINERS_ARCHIVE_ARCHIVE_HPP_
 
 #include <stdint.h>
+#include <string.h>
 
 #include <string>
 #include <type_traits>
@@ -115,7 +116,17 @@ public:
     explicit write_message_t(write_message_t &&) = default;
     ~write_message_t();
 
-    void append(const void *p, int64_t n);
+    // Most writes are a handful of bytes that fit into the last buffer, so that
+    // case is handled inline.
+    void append(const void *p, int64_t n) {
+        write_buffer_t *b = buffers_.tail();
+        if (b != nullptr && n <= write_buffer_t::DATA_SIZE - b->size) {
+            memcpy(b->data + b->size, p, n);
+            b->size += n;
+        } else {
+            append_slow(p, n);
+        }
+    }
 
     size_t size() const;
 
@@ -124,6 +135,8 @@ public:
 private:
     friend int send_write_message(write_stream_t *s, const write_message_t *wm);
 
+    void append_slow(const void *p, int64_t n);
+
     intrusive_list_t<write_buffer_t> buffers_;
 
     DISABLE_COPYING(write_message_t);
@@ -142,6 +155,11 @@ struct serialized_size_t;
 template <class T>
 struct serialize_universal_size_t;
 
+// True for types whose serialization is their raw in-memory representation, so
+// that a contiguous array of them can be written or read with a single copy.
+template <class T>
+struct raw_serializable_t : public std::false_type { };
+
 // Makes typ1 serializable, sending a typ2 over the wire.  Has range
 // checking on the closed interval [lo, hi] when deserializing.
 #define ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(typ1, typ2, lo, hi)       \
@@ -225,7 +243,9 @@ struct serialize_universal_size_t;
         : public std::integral_constant<size_t, sizeof(typ)> { }; /* NOLINT(readability/braces) */       \
     template <>                                                         \
     struct serialize_universal_size_t<typ>                              \
-        : public std::integral_constant<size_t, sizeof(typ)> { }
+        : public std::integral_constant<size_t, sizeof(typ)> { }; /* NOLINT(readability/braces) */ \
+    template <>                                                         \
+    struct raw_serializable_t<typ> : public std::true_type { }
 
 
 ARCHIVE_PRIM_MAKE_RAW_SERIALIZABLE(unsigned char);  // NOLINT(runtime/int)
@@ -136,28 +136,75 @@ MUST_USE archive_result_t deserialize(read_stream_t *s, std::string *out) {
 }
 
 
-// Think twice before using this function on vectors containing a primitive type --
-// it'll take O(n) time!
-// Keep in sync with serialize.
+// Vectors of primitive types that are sent raw over the wire are copied in one
+// go.  This produces exactly the same bytes as serializing them one at a time.
 template <cluster_version_t W, class T>
-size_t serialized_size(const std::vector<T> &v) {
-    size_t ret = varint_uint64_serialized_size(v.size());
+size_t serialized_vector_elements_size(const std::vector<T> &v, std::true_type) {
+    return v.size() * serialized_size_t<T>::value;
+}
+
+template <cluster_version_t W, class T>
+size_t serialized_vector_elements_size(const std::vector<T> &v, std::false_type) {
+    size_t ret = 0;
     for (auto it = v.begin(), e = v.end(); it != e; ++it) {
         ret += serialized_size<W>(*it);
     }
     return ret;
 }
 
+template <cluster_version_t W, class T>
+void serialize_vector_elements(write_message_t *wm, const std::vector<T> &v,
+                               std::true_type) {
+    wm->append(v.data(), v.size() * sizeof(T));
+}
 
-// Keep in sync with serialized_size.
 template <cluster_version_t W, class T>
-void serialize(write_message_t *wm, const std::vector<T> &v) {
-    serialize_varint_uint64(wm, v.size());
+void serialize_vector_elements(write_message_t *wm, const std::vector<T> &v,
+                               std::false_type) {
     for (auto it = v.begin(), e = v.end(); it != e; ++it) {
         serialize<W>(wm, *it);
     }
 }
 
+template <cluster_version_t W, class T>
+MUST_USE archive_result_t deserialize_vector_elements(read_stream_t *s,
+                                                      std::vector<T> *v,
+                                                      std::true_type) {
+    const int64_t sz = v->size() * sizeof(T);
+    int64_t res = force_read(s, v->data(), sz);
+    if (res == -1) { return archive_result_t::SOCK_ERROR; }
+    if (res < sz) { return archive_result_t::SOCK_EOF; }
+    return archive_result_t::SUCCESS;
+}
+
+template <cluster_version_t W, class T>
+MUST_USE archive_result_t deserialize_vector_elements(read_stream_t *s,
+                                                      std::vector<T> *v,
+                                                      std::false_type) {
+    for (size_t i = 0; i < v->size(); ++i) {
+        archive_result_t res = deserialize<W>(s, &(*v)[i]);
+        if (bad(res)) { return res; }
+    }
+    return archive_result_t::SUCCESS;
+}
+
+// Think twice before using this function on vectors containing a non-primitive
+// type -- it'll take O(n) time!
+// Keep in sync with serialize.
+template <cluster_version_t W, class T>
+size_t serialized_size(const std::vector<T> &v) {
+    return varint_uint64_serialized_size(v.size())
+        + serialized_vector_elements_size<W>(v, raw_serializable_t<T>());
+}
+
+
+// Keep in sync with serialized_size.
+template <cluster_version_t W, class T>
+void serialize(write_message_t *wm, const std::vector<T> &v) {
+    serialize_varint_uint64(wm, v.size());
+    serialize_vector_elements<W>(wm, v, raw_serializable_t<T>());
+}
+
 template <cluster_version_t W, class T>
 MUST_USE archive_result_t deserialize(read_stream_t *s, std::vector<T> *v) {
     v->clear();
@@ -166,17 +213,12 @@ MUST_USE archive_result_t deserialize(read_stream_t *s, std::vector<T> *v) {
     archive_result_t res = deserialize_varint_uint64(s, &sz);
     if (bad(res)) { return res; }
 
-    if (sz > std::numeric_limits<size_t>::max()) {
+    if (sz > std::numeric_limits<size_t>::max() / sizeof(T)) {
         return archive_result_t::RANGE_ERROR;
     }
 
     v->resize(sz);
-    for (uint64_t i = 0; i < sz; ++i) {
-        res = deserialize<W>(s, &(*v)[i]);
-        if (bad(res)) { return res; }
-    }
-
-    return archive_result_t::SUCCESS;
+    return deserialize_vector_elements<W>(s, v, raw_serializable_t<T>());
 }
 
 template <cluster_version_t W, class T>
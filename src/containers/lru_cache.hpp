@@ -34,6 +34,13 @@ public:
     // Returns true if an insertion was performed.  (Does nothing, doesn't even update
     // LRU, if no insertion was performed.)
     bool insert(K key, V value) {
+        return insert(std::move(key), std::move(value), [](const K &, V &&) { });
+    }
+
+    // Like `insert`, but calls `on_evict(key, std::move(value))` for the entry that
+    // gets pushed out of the cache, if any.
+    template <class callable_t>
+    bool insert(K key, V value, callable_t &&on_evict) {
         auto it = map_.find(key);
         if (it != map_.end()) {
             return false;
@@ -42,6 +49,7 @@ public:
                 list_iterator evictee = list_.begin();
                 DEBUG_VAR size_t count = map_.erase(evictee->first);
                 rassert(count == 1);
+                on_evict(evictee->first, std::move(evictee->second));
                 list_.pop_front();
             }
 
@@ -27,6 +27,7 @@
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/geo_traversal.hpp"
 #include "rdb_protocol/lazy_btree_val.hpp"
+#include "rdb_protocol/parallel_terminal.hpp"
 #include "rdb_protocol/pseudo_geometry.hpp"
 #include "rdb_protocol/serialize_datum_onto_blob.hpp"
 #include "rdb_protocol/shards.hpp"
@@ -641,6 +642,8 @@ public:
                sorting_t _sorting,
                require_sindexes_t require_sindex_val)
         : env(_env),
+          transforms(_transforms),
+          terminal(_terminal),
           batcher(make_scoped<ql::batcher_t>(batchspec.to_batcher())),
           sorting(_sorting),
           accumulator(_terminal.has_value()
@@ -663,6 +666,9 @@ public:
 private:
     friend class rget_cb_t;
     ql::env_t *const env;
+    // Only kept around for `rget_cb_t::maybe_parallelize()`.
+    std::vector<transform_variant_t> transforms;
+    optional<terminal_variant_t> terminal;
     scoped_ptr_t<ql::batcher_t> batcher;
     std::vector<scoped_ptr_t<ql::op_t> > transformers;
     sorting_t sorting;
@@ -693,6 +699,11 @@ public:
         concurrent_traversal_fifo_enforcer_signal_t waiter)
         THROWS_ONLY(interrupted_exc_t);
     void finish(continue_bool_t last_cb) THROWS_ONLY(interrupted_exc_t);
+
+    // Hands the rows to a `ql::parallel_terminal_t` rather than evaluating them
+    // in `handle_pair`, if the job is an aggregation that supports it.  Only
+    // valid for traversals of the primary index.
+    void maybe_parallelize();
 private:
     const rget_io_data_t io; // How do get data in/out.
     job_data_t job; // What to do next (stateful).
@@ -700,6 +711,8 @@ private:
 
     scoped_ptr_t<ql::env_t> sindex_env;
 
+    scoped_ptr_t<ql::parallel_terminal_t> parallel;
+
     // State for internal bookkeeping.
     bool bad_init;
     optional<std::string> last_truncated_secondary_for_abort;
@@ -732,6 +745,94 @@ private:
     optional<std::string> skey_left;
 };
 
+// Like `rget_cb_wrapper_t`, but for a single traversal over several disjoint key
+// ranges (e.g. the keys of a `get_all`).  Subtrees and keys outside of the ranges
+// are skipped, so that the internal nodes are only acquired once for all ranges
+// instead of once per range.
+class rget_multi_range_cb_wrapper_t : public concurrent_traversal_callback_t {
+public:
+    struct range_info_t {
+        key_range_t range;
+        size_t copies;
+        optional<std::string> skey_left;
+    };
+
+    // `_ranges` is keyed by the left bound of each range.
+    rget_multi_range_cb_wrapper_t(
+            rget_cb_t *_cb,
+            std::map<store_key_t, range_info_t> &&_ranges)
+        : cb(_cb), ranges(std::move(_ranges)) {
+        guarantee(!ranges.empty());
+    }
+
+    // Returns false if some of the ranges overlap (which can happen for truncated
+    // secondary index keys).
+    static bool disjoint(const std::map<store_key_t, range_info_t> &ranges) {
+        for (auto it = ranges.begin(); it != ranges.end(); ++it) {
+            auto next = it;
+            ++next;
+            if (next != ranges.end()
+                && (it->second.range.right.unbounded
+                    || next->first < it->second.range.right.key())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The smallest range containing all of the ranges.
+    key_range_t hull() const {
+        key_range_t res = ranges.begin()->second.range;
+        res.right = ranges.rbegin()->second.range.right;
+        return res;
+    }
+
+    virtual void filter_range(
+            const btree_key_t *left_excl_or_null,
+            const btree_key_t *right_incl,
+            bool *skip_out) {
+        // Only the last range that starts at or before `right_incl` can end after
+        // `left_excl_or_null`, because the ranges are disjoint.
+        const range_info_t *info = last_range_starting_before(right_incl);
+        *skip_out = info == nullptr
+            || (left_excl_or_null != nullptr
+                && !info->range.right.unbounded
+                && btree_key_cmp(info->range.right.key().btree_key(),
+                                 left_excl_or_null) <= 0);
+    }
+
+    virtual void filter_key(const btree_key_t *key, bool *skip_out) {
+        const range_info_t *info = last_range_starting_before(key);
+        *skip_out = info == nullptr || !info->range.contains_key(key);
+    }
+
+    virtual continue_bool_t handle_pair(
+        scoped_key_value_t &&keyvalue,
+        concurrent_traversal_fifo_enforcer_signal_t waiter)
+        THROWS_ONLY(interrupted_exc_t) {
+        const range_info_t *info = last_range_starting_before(keyvalue.key());
+        guarantee(info != nullptr && info->range.contains_key(keyvalue.key()));
+        return cb->handle_pair(
+            std::move(keyvalue),
+            info->copies,
+            info->skey_left,
+            std::move(waiter));
+    }
+
+private:
+    const range_info_t *last_range_starting_before(const btree_key_t *key) const {
+        auto it = ranges.upper_bound(store_key_t(key));
+        if (it == ranges.begin()) {
+            return nullptr;
+        }
+        --it;
+        return &it->second;
+    }
+
+    rget_cb_t *cb;
+    const std::map<store_key_t, range_info_t> ranges;
+};
+
 rget_cb_t::rget_cb_t(rget_io_data_t &&_io,
                      job_data_t &&_job,
                      optional<rget_sindex_data_t> &&_sindex)
@@ -758,7 +859,24 @@ rget_cb_t::rget_cb_t(rget_io_data_t &&_io,
 }
 
 void rget_cb_t::finish(continue_bool_t last_cb) THROWS_ONLY(interrupted_exc_t) {
-    job.accumulator->finish(last_cb, &io.response->result);
+    if (parallel.has()) {
+        parallel->finish(job.accumulator.get(), last_cb, &io.response->result);
+    } else {
+        job.accumulator->finish(last_cb, &io.response->result);
+    }
+}
+
+void rget_cb_t::maybe_parallelize() {
+    guarantee(!sindex);
+    if (job.terminal.has_value()
+        && ql::parallel_terminal_t::can_parallelize(job.env,
+                                                    job.transforms,
+                                                    *job.terminal,
+                                                    job.accumulator->uses_val())) {
+        parallel.init(new ql::parallel_terminal_t(job.env,
+                                                  job.transforms,
+                                                  *job.terminal));
+    }
 }
 
 // Handle a keyvalue pair.  Returns whether or not we're done early.
@@ -973,6 +1091,14 @@ continue_bool_t rget_cb_t::handle_pair(
             }
         }
 
+        if (parallel.has()) {
+            if (parallel->has_error()) {
+                return continue_bool_t::ABORT;
+            }
+            parallel->add_row(std::move(val), copies);
+            return continue_bool_t::CONTINUE;
+        }
+
         ql::groups_t data = {{ql::datum_t(), ql::datums_t(copies, val)}};
 
         for (auto it = job.transformers.begin(); it != job.transformers.end(); ++it) {
@@ -1040,35 +1166,22 @@ void rdb_rget_slice(
     direction_t direction = reversed(sorting) ? BACKWARD : FORWARD;
     continue_bool_t cont = continue_bool_t::CONTINUE;
     if (primary_keys.has_value()) {
-        auto cb = [&](const std::pair<store_key_t, uint64_t> &pair, bool is_last) {
-            rget_cb_wrapper_t wrapper(&callback, pair.second, r_nullopt);
-            return btree_concurrent_traversal(
-                superblock,
-                key_range_t::one_key(pair.first),
-                &wrapper,
-                direction,
-                is_last ? release_superblock : release_superblock_t::KEEP);
-        };
-        if (!reversed(sorting)) {
-            for (auto it = primary_keys->begin(); it != primary_keys->end();) {
-                auto this_it = it++;
-                if (cb(*this_it, it == primary_keys->end()) == continue_bool_t::ABORT) {
-                    // If required the superblock will get released further up the stack.
-                    cont = continue_bool_t::ABORT;
-                    break;
-                }
-            }
-        } else {
-            for (auto it = primary_keys->rbegin(); it != primary_keys->rend();) {
-                auto this_it = it++;
-                if (cb(*this_it, it == primary_keys->rend()) == continue_bool_t::ABORT) {
-                    // If required the superblock will get released further up the stack.
-                    cont = continue_bool_t::ABORT;
-                    break;
-                }
+        // All keys are read in a single traversal, rather than descending the tree
+        // once per key.
+        std::map<store_key_t, rget_multi_range_cb_wrapper_t::range_info_t> ranges;
+        for (const auto &pair : *primary_keys) {
+            if (range.contains_key(pair.first)) {
+                ranges[pair.first] = rget_multi_range_cb_wrapper_t::range_info_t{
+                    key_range_t::one_key(pair.first), pair.second, r_nullopt};
             }
         }
+        if (!ranges.empty()) {
+            rget_multi_range_cb_wrapper_t wrapper(&callback, std::move(ranges));
+            cont = btree_concurrent_traversal(
+                superblock, wrapper.hull(), &wrapper, direction, release_superblock);
+        }
     } else {
+        callback.maybe_parallelize();
         rget_cb_wrapper_t wrapper(&callback, 1, r_nullopt);
         cont = btree_concurrent_traversal(
             superblock, range, &wrapper, direction, release_superblock);
@@ -1124,6 +1237,48 @@ void rdb_rget_secondary_slice(
             sindex_info.multi)));
 
     direction_t direction = reversed(sorting) ? BACKWARD : FORWARD;
+
+    // If we're looking for several disjoint sindex values (e.g. `get_all` with many
+    // keys), we read all of them in a single traversal.
+    std::map<store_key_t, rget_multi_range_cb_wrapper_t::range_info_t> ranges;
+    bool overlapping = false;
+    const bool multiple_ranges = datumspec.visit<bool>(
+        [](const ql::datum_range_t &) { return false; },
+        [](const std::map<ql::datum_t, uint64_t> &m) { return m.size() > 1; });
+    if (multiple_ranges) {
+        datumspec.iter(sorting,
+            [&](const std::pair<ql::datum_range_t, uint64_t> &pair, bool) {
+                key_range_t sindex_keyrange =
+                    pair.first.to_sindex_keyrange(sindex_func_reql_version);
+                key_range_t active_range =
+                    active_region_range.intersection(sindex_keyrange);
+                if (!active_range.is_empty()) {
+                    auto res = ranges.insert(std::make_pair(
+                        active_range.left,
+                        rget_multi_range_cb_wrapper_t::range_info_t{
+                            active_range,
+                            pair.second,
+                            make_optional(
+                                key_to_unescaped_str(sindex_keyrange.left))}));
+                    if (!res.second) {
+                        // Two values map to the same truncated key range.
+                        overlapping = true;
+                        return continue_bool_t::ABORT;
+                    }
+                }
+                return continue_bool_t::CONTINUE;
+            });
+    }
+    if (!ranges.empty()
+        && !overlapping
+        && rget_multi_range_cb_wrapper_t::disjoint(ranges)) {
+        rget_multi_range_cb_wrapper_t wrapper(&callback, std::move(ranges));
+        continue_bool_t cont = btree_concurrent_traversal(
+            superblock, wrapper.hull(), &wrapper, direction, release_superblock);
+        callback.finish(cont);
+        return;
+    }
+
     auto cb = [&](const std::pair<ql::datum_range_t, uint64_t> &pair, bool is_last) {
         key_range_t sindex_keyrange =
             pair.first.to_sindex_keyrange(sindex_func_reql_version);
@@ -2,6 +2,7 @@
 #include "rdb_protocol/changefeed.hpp"
 
 #include <queue>
+#include <set>
 
 #include "btree/reql_specific.hpp"
 #include "clustering/administration/auth/user_context.hpp"
@@ -9,6 +10,7 @@
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/interruptor.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "containers/archive/vector_stream.hpp"
 #include "rdb_protocol/artificial_table/backend.hpp"
 #include "rdb_protocol/btree.hpp"
 #include "rdb_protocol/env.hpp"
@@ -16,8 +18,11 @@
 #include "rdb_protocol/geo/intersection.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/response.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
 #include "rdb_protocol/val.hpp"
+#include "perfmon/perfmon.hpp"
 #include "rpc/mailbox/typed.hpp"
+#include "thread_local.hpp"
 
 #include "debug.hpp"
 
@@ -164,44 +169,140 @@ void debug_print(printf_buffer_t *buf, const T &t) {
     buf->appendf("%s", debug::print(t).c_str());
 }
 
+// The approximate amount of memory used by the changes queued up in the
+// subscriptions on this thread.  Each thread gets an equal share of
+// `CHANGEFEED_MEMORY_BUDGET`.
+TLS_with_init(int64_t, changefeed_queued_bytes, 0);
+
+static perfmon_counter_t pm_changefeed_queued_changes, pm_changefeed_queued_bytes,
+    pm_changefeed_squashed_subscriptions;
+static perfmon_multi_membership_t pm_changefeed_membership(
+    &get_global_perfmon_collection(),
+    &pm_changefeed_queued_changes, "changefeed_queued_changes",
+    &pm_changefeed_queued_bytes, "changefeed_queued_bytes",
+    &pm_changefeed_squashed_subscriptions, "changefeed_squashed_subscriptions");
+
+bool changefeed_memory_budget_exceeded() {
+    return TLS_get_changefeed_queued_bytes()
+        > CHANGEFEED_MEMORY_BUDGET / get_num_threads();
+}
+
+// The approximate amount of memory used by a value in a subscription queue.
+// Computing this means serializing the value, so `msg_visitor_t` computes it once
+// per value and passes it to all the subscriptions that queue the value.
+size_t queued_datum_size(const datum_t &val) {
+    return val.has()
+        ? datum_serialized_size(val, check_datum_serialization_errors_t::NO)
+        : 0;
+}
+
+// A change in a subscription queue, along with the sizes of its values.
+struct queued_change_val_t {
+    queued_change_val_t(change_val_t &&_change_val,
+                        size_t _old_val_size,
+                        size_t _new_val_size)
+        : change_val(std::move(_change_val)),
+          old_val_size(_old_val_size),
+          new_val_size(_new_val_size) { }
+    size_t size() const {
+        return sizeof(change_val_t) + change_val.pkey.size()
+            + old_val_size + new_val_size;
+    }
+    change_val_t change_val;
+    size_t old_val_size, new_val_size;
+};
+
 enum class pop_type_t { RANGE, POINT };
-class maybe_squashing_queue_t {
+class maybe_squashing_queue_t : public home_thread_mixin_debug_only_t {
 public:
-    virtual ~maybe_squashing_queue_t() { }
-    virtual void add(change_val_t change_val) = 0;
+    maybe_squashing_queue_t() : count(0), bytes(0) { }
+    virtual ~maybe_squashing_queue_t() {
+        forget_all();
+    }
+    virtual bool is_squashing() const = 0;
+    void add(change_val_t change_val, size_t old_val_size, size_t new_val_size) {
+        add_queued(queued_change_val_t(
+            std::move(change_val), old_val_size, new_val_size));
+    }
+    change_val_t pop() {
+        return pop_queued().change_val;
+    }
+    // These don't recompute the sizes of the changes, so they should be used to
+    // move changes from one queue to another.
+    virtual void add_queued(queued_change_val_t queued) = 0;
+    virtual queued_change_val_t pop_queued() = 0;
     virtual size_t size() const = 0;
     virtual void clear() = 0;
-    virtual change_val_t pop() = 0;
     virtual const change_val_t &peek() = 0;
     virtual void purge_below(std::map<uuid_u, uint64_t> stamps) = 0;
+protected:
+    // These keep track of the memory used by the queued changes.
+    void note_added(const queued_change_val_t &queued) {
+        assert_thread();
+        size_t cv_bytes = queued.size();
+        count += 1;
+        bytes += cv_bytes;
+        TLS_set_changefeed_queued_bytes(TLS_get_changefeed_queued_bytes() + cv_bytes);
+        pm_changefeed_queued_bytes += cv_bytes;
+        ++pm_changefeed_queued_changes;
+    }
+    void note_removed(const queued_change_val_t &queued) {
+        assert_thread();
+        size_t cv_bytes = queued.size();
+        guarantee(count > 0 && bytes >= cv_bytes);
+        count -= 1;
+        bytes -= cv_bytes;
+        TLS_set_changefeed_queued_bytes(TLS_get_changefeed_queued_bytes() - cv_bytes);
+        pm_changefeed_queued_bytes -= cv_bytes;
+        --pm_changefeed_queued_changes;
+    }
+    // Must be called whenever the queue is emptied without `note_removed`.
+    void forget_all() {
+        assert_thread();
+        TLS_set_changefeed_queued_bytes(TLS_get_changefeed_queued_bytes() - bytes);
+        pm_changefeed_queued_bytes -= bytes;
+        pm_changefeed_queued_changes -= count;
+        count = 0;
+        bytes = 0;
+    }
+private:
+    size_t count, bytes;
 };
 
 class nonsquashing_queue_t final : public maybe_squashing_queue_t {
-    void add(change_val_t change_val) final {
-        queue.push_back(std::move(change_val));
+    bool is_squashing() const final {
+        return false;
+    }
+    void add_queued(queued_change_val_t queued) final {
+        note_added(queued);
+        queue.push_back(std::move(queued));
     }
     size_t size() const final {
         return queue.size();
     }
     void clear() final {
+        forget_all();
         queue.clear();
     }
     const change_val_t &peek() final {
         guarantee(size() != 0);
-        return queue.front();
+        return queue.front().change_val;
     }
-    change_val_t pop() final {
+    queued_change_val_t pop_queued() final {
         guarantee(size() != 0);
+        note_removed(queue.front());
         auto ret = std::move(queue.front());
         queue.pop_front();
         return ret;
     }
     void purge_below(std::map<uuid_u, uint64_t> stamps) final {
         std::map<uuid_u, uint64_t> orig, kept;
-        std::deque<change_val_t> old_queue;
+        std::deque<queued_change_val_t> old_queue;
+        forget_all();
         old_queue.swap(queue);
         guarantee(queue.empty());
-        for (auto &&cv : old_queue) {
+        for (auto &&queued : old_queue) {
+            const change_val_t &cv = queued.change_val;
             auto it = stamps.find(cv.source_stamp.first);
             orig.insert(std::make_pair(cv.source_stamp.first, 0)).first->second += 1;
             r_sanity_check(it != stamps.end());
@@ -210,29 +311,37 @@ class nonsquashing_queue_t final : public maybe_squashing_queue_t {
             if (cv.source_stamp.second >= it->second) {
                 kept.insert(
                     std::make_pair(cv.source_stamp.first, 0)).first->second += 1;
-                add(std::move(cv));
+                add_queued(std::move(queued));
             }
         }
     }
-    std::deque<change_val_t> queue;
+    std::deque<queued_change_val_t> queue;
 };
 
 class squashing_queue_t final : public maybe_squashing_queue_t {
 public:
-    void add(change_val_t change_val) final {
-        auto it = queue.find(change_val.pkey);
+    bool is_squashing() const final {
+        return true;
+    }
+    void add_queued(queued_change_val_t queued) final {
+        auto it = queue.find(queued.change_val.pkey);
         if (it == queue.end()) {
-            auto order_it = queue_order.insert(queue_order.end(), change_val.pkey);
-            auto pkey = change_val.pkey;
+            note_added(queued);
+            auto order_it = queue_order.insert(
+                queue_order.end(), queued.change_val.pkey);
+            auto pkey = queued.change_val.pkey;
             auto pair = std::make_pair(
-                std::move(pkey), std::make_pair(std::move(change_val), order_it));
+                std::move(pkey), std::make_pair(std::move(queued), order_it));
             auto res = queue.insert(std::move(pair));
             it = res.first;
             guarantee(res.second);
         } else {
-            change_val_t *change = &it->second.first;
-            change_val.old_val = std::move(change->old_val);
-            *change = std::move(change_val);
+            queued_change_val_t *old = &it->second.first;
+            note_removed(*old);
+            queued.change_val.old_val = std::move(old->change_val.old_val);
+            queued.old_val_size = old->old_val_size;
+            *old = std::move(queued);
+            const change_val_t *change = &old->change_val;
             bool has_old_val = change->old_val
                 && change->old_val->val.get_type() != datum_t::R_NULL;
             bool has_new_val = change->new_val
@@ -242,6 +351,8 @@ public:
                     && change->old_val->val == change->new_val->val)) {
                 queue_order.erase(it->second.second);
                 queue.erase(it);
+            } else {
+                note_added(*old);
             }
         }
     }
@@ -250,6 +361,7 @@ public:
         return queue.size();
     }
     void clear() final {
+        forget_all();
         queue.clear();
         queue_order.clear();
     }
@@ -257,12 +369,13 @@ public:
         guarantee(size() != 0);
         auto it = queue.find(*queue_order.begin());
         guarantee(it != queue.end());
-        return it->second.first;
+        return it->second.first.change_val;
     }
-    change_val_t pop() final {
+    queued_change_val_t pop_queued() final {
         guarantee(size() != 0);
         auto it = queue.find(*queue_order.begin());
         guarantee(it != queue.end());
+        note_removed(it->second.first);
         auto ret = std::move(it->second.first);
         queue.erase(it);
         queue_order.pop_front();
@@ -274,7 +387,8 @@ public:
     }
 private:
     std::map<store_key_t,
-             std::pair<change_val_t, std::list<store_key_t>::iterator> > queue;
+             std::pair<queued_change_val_t,
+                       std::list<store_key_t>::iterator> > queue;
     std::list<store_key_t> queue_order;
 };
 
@@ -401,6 +515,7 @@ void server_t::add_client(
     // oversharded.  This will have to become smarter once you can unsubscribe
     // at finer granularity (i.e. when we support changefeeds on selections).
     info->regions.push_back(std::move(region));
+    rebuild_client_index();
 
     // The entry might already exist if we have multiple shards per btree, but
     // that's fine.
@@ -484,6 +599,43 @@ void server_t::add_client_cb(
     // This is true even if we have multiple shards per btree because
     // `add_client` only spawns one of us.
     guarantee(erased == 1);
+    rebuild_client_index();
+}
+
+void server_t::rebuild_client_index() {
+    client_index.clear();
+    if (clients.empty()) {
+        return;
+    }
+    // The bounds of all regions split the key space into ranges which are either
+    // entirely inside or entirely outside of each region.
+    std::set<store_key_t> bounds;
+    bounds.insert(store_key_t::min());
+    for (const auto &pair : clients) {
+        for (const region_t &region : pair.second.regions) {
+            bounds.insert(region.inner.left);
+            if (!region.inner.right.unbounded) {
+                bounds.insert(region.inner.right.key());
+            }
+        }
+    }
+    for (const store_key_t &bound : bounds) {
+        std::vector<indexed_client_t> entry;
+        for (auto &&pair : clients) {
+            for (const region_t &region : pair.second.regions) {
+                if (region.inner.contains_key(bound)) {
+                    entry.push_back(std::make_pair(&pair, &region));
+                }
+            }
+        }
+        // Neighbouring ranges usually have the same clients.
+        if (!client_index.empty()
+            && client_index.rbegin()->second == entry) {
+            continue;
+        }
+        client_index.insert(
+            client_index.end(), std::make_pair(bound, std::move(entry)));
+    }
 }
 
 struct stamped_msg_t {
@@ -499,6 +651,36 @@ struct stamped_msg_t {
 
 RDB_MAKE_SERIALIZABLE_3(stamped_msg_t, server_uuid, stamp, submsg);
 
+// Writes a `stamped_msg_t` whose `submsg` has already been serialized, so that
+// `send_all` only has to serialize a change once no matter how many clients it
+// goes to.  What ends up on the wire is exactly what
+// `send(manager, addr, stamped_msg_t(...))` would have produced, so the clients
+// receive it in the usual way.
+class stamped_msg_writer_t : public mailbox_write_callback_t {
+public:
+    stamped_msg_writer_t(const uuid_u &_server_uuid,
+                         uint64_t _stamp,
+                         const std::vector<char> *_serialized_submsg)
+        : server_uuid(_server_uuid),
+          stamp(_stamp),
+          serialized_submsg(_serialized_submsg) { }
+    void write(DEBUG_VAR cluster_version_t cluster_version, write_message_t *wm) {
+        rassert(cluster_version == cluster_version_t::CLUSTER);
+        serialize<cluster_version_t::CLUSTER>(wm, server_uuid);
+        serialize<cluster_version_t::CLUSTER>(wm, stamp);
+        wm->append(serialized_submsg->data(), serialized_submsg->size());
+    }
+#ifdef ENABLE_MESSAGE_PROFILER
+    const char *message_profiler_tag() const {
+        return "mailbox<stamped_msg_t>";
+    }
+#endif
+private:
+    const uuid_u &server_uuid;
+    const uint64_t stamp;
+    const std::vector<char> *const serialized_submsg;
+};
+
 // This function takes a `lock_t` to make sure you have one.  (We can't just
 // always acquire a drainer lock before sending because we sometimes send a
 // `stop_t` during destruction, and you can't acquire a drain lock on a draining
@@ -529,20 +711,39 @@ void server_t::send_all(
 
     rwlock_acq_t acq(&clients_lock, access_t::read);
     std::map<client_t::addr_t, uint64_t> stamps;
-    for (auto &&pair : clients) {
+    auto it = client_index.upper_bound(key);
+    if (it != client_index.begin()) {
+        --it;
         // We don't need a write lock as long as we make sure the coroutine
         // doesn't block between reading and updating the stamp.
         ASSERT_NO_CORO_WAITING;
-        if (std::any_of(pair.second.regions.begin(),
-                        pair.second.regions.end(),
-                        std::bind(&region_contains_key, ph::_1, std::cref(key)))) {
-            stamps[pair.first] = pair.second.stamp++;
+        for (const indexed_client_t &indexed : it->second) {
+            // A client that is subscribed to several regions (if we're
+            // oversharded) must only be stamped once.
+            if (region_contains_key(*indexed.second, key)
+                && stamps.count(indexed.first->first) == 0) {
+                stamps[indexed.first->first] = indexed.first->second.stamp++;
+            }
         }
     }
     acq.reset();
     stamp_spot->reset(); // Done stamping, no need to hold onto it while we send.
+    if (stamps.empty()) {
+        return;
+    }
+    std::vector<char> serialized_msg;
+    {
+        write_message_t wm;
+        serialize<cluster_version_t::CLUSTER>(&wm, msg);
+        vector_stream_t stream;
+        stream.reserve(wm.size());
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+        stream.swap(&serialized_msg);
+    }
     for (const auto &pair : stamps) {
-        send(manager, pair.first, stamped_msg_t(uuid, pair.second, msg));
+        stamped_msg_writer_t writer(uuid, pair.second, &serialized_msg);
+        send_with_writer(manager, pair.first, &writer);
     }
 }
 
@@ -872,6 +1073,9 @@ limit_manager_t::limit_manager_t(
       spec(std::move(_spec)),
       gt(std::move(_gt)),
       item_queue(gt),
+      reserve(gt),
+      max_reserve(std::min<size_t>(spec.limit, MAX_LIMIT_CHANGEFEED_RESERVE)),
+      reserve_complete(false),
       aborted(false) {
     guarantee(clients_lock->read_signal()->is_pulsed());
 
@@ -941,14 +1145,16 @@ public:
                   const keyspec_t::limit_t *_spec,
                   sorting_t _sorting,
                   optional<item_t> _start,
-                  const item_queue_t *_item_queue)
+                  size_t _n,
+                  size_t _start_duplicates)
         : env(_env),
           ops(_ops),
           pk_range(_pk_range),
           spec(_spec),
           sorting(_sorting),
           start(std::move(_start)),
-          item_queue(_item_queue) { }
+          n(_n),
+          start_duplicates(_start_duplicates) { }
 
     std::vector<item_t> operator()(const primary_ref_t &ref) {
         rget_read_response_t resp;
@@ -971,7 +1177,6 @@ public:
         case sorting_t::UNORDERED: // fallthru
         default: unreachable();
         }
-        size_t n = spec->limit - item_queue->size();
         rdb_rget_slice(
             ref.btree,
             region_t(),
@@ -1026,7 +1231,7 @@ public:
                 [](const datum_range_t &) { return true; },
                 [](const std::map<datum_t, uint64_t> &) { return false; }));
         datum_range_t srange = spec->range.datumspec.covering_range();
-        size_t n = spec->limit - item_queue->size();
+        size_t to_read = n;
         if (start) {
             datum_t dstart = start->second.first;
             switch (sorting) {
@@ -1041,12 +1246,7 @@ public:
             }
 
             // Because we're using closed bounds, we have to make sure to read enough.
-            for (const auto &pair : *item_queue) {
-                if (pair->second.first != dstart) {
-                    break;
-                }
-                n += 1;
-            }
+            to_read += start_duplicates;
         }
         reql_version_t reql_version =
             ref.sindex_info->mapping_version_info.latest_compatible_reql_version;
@@ -1061,7 +1261,7 @@ public:
             std::vector<transform_variant_t>(),
             optional<terminal_variant_t>(limit_read_t{
                     is_primary_t::NO,
-                    n,
+                    to_read,
                     // This code uses the same generic code path as a normal
                     // read, and a normal read needs to keep track of the
                     // region and last seen key for unsharding, but we
@@ -1089,7 +1289,7 @@ public:
         if (stream.substreams.size() == 1) {
             raw_stream_t *raw_stream = &stream.substreams.begin()->second.stream;
             item_vec = mangle_sort_truncate_stream(
-                std::move(*raw_stream), is_primary_t::NO, sorting, n);
+                std::move(*raw_stream), is_primary_t::NO, sorting, to_read);
         } else {
             guarantee(item_vec.size() == 0);
         }
@@ -1103,18 +1303,84 @@ private:
     const keyspec_t::limit_t *spec;
     sorting_t sorting;
     optional<item_t> start;
-    const item_queue_t *item_queue;
+    size_t n;
+    // The number of rows we already have whose secondary index value is the same
+    // as `start`'s.
+    size_t start_duplicates;
 };
 
 std::vector<item_t> limit_manager_t::read_more(
     const boost::variant<primary_ref_t, sindex_ref_t> &ref,
-    const optional<item_t> &start) {
+    const optional<item_t> &start,
+    size_t n) {
     guarantee(item_queue.size() < spec.limit);
-    ref_visitor_t visitor(
-        env.get(), &ops, &region.inner, &spec, spec.range.sorting, start, &item_queue);
+    size_t start_duplicates = 0;
+    if (start) {
+        // `start` is the last row we have, so rows with the same secondary index
+        // value are at the beginning of the queues.
+        for (const item_queue_t *queue : {&reserve, &item_queue}) {
+            for (const auto &it : *queue) {
+                if (it->second.first != start->second.first) {
+                    break;
+                }
+                start_duplicates += 1;
+            }
+        }
+    }
+    ref_visitor_t visitor(env.get(), &ops, &region.inner, &spec, spec.range.sorting,
+                          start, n, start_duplicates);
     return boost::apply_visitor(visitor, ref);
 }
 
+void limit_manager_t::rebalance(item_queue_t *real_added,
+                                std::set<std::string> *real_deleted) {
+    // The worst row of a queue is at the beginning, and the best row at the end.
+    auto demote = [&]() {
+        auto it = item_queue.begin();
+        item_t item(**it);
+        item_queue.erase(it);
+        auto added_it = real_added->find_id(item.first);
+        if (added_it != real_added->end()) {
+            real_added->erase(added_it);
+        } else {
+            bool inserted = real_deleted->insert(item.first).second;
+            guarantee(inserted);
+        }
+        bool inserted = reserve.insert(std::move(item)).second;
+        guarantee(inserted);
+    };
+    auto promote = [&]() {
+        auto it = reserve.end();
+        --it;
+        item_t item(**it);
+        reserve.erase(it);
+        bool inserted = real_added->insert(item).second;
+        guarantee(inserted);
+        inserted = item_queue.insert(std::move(item)).second;
+        guarantee(inserted);
+    };
+    while (item_queue.size() > spec.limit) {
+        demote();
+    }
+    while (item_queue.size() < spec.limit && reserve.size() != 0) {
+        promote();
+    }
+    // Rows that were added to `item_queue` may be worse than rows in `reserve`.
+    while (item_queue.size() != 0 && reserve.size() != 0) {
+        auto best_reserved = reserve.end();
+        --best_reserved;
+        if (!gt(*item_queue.begin(), *best_reserved)) {
+            break;
+        }
+        demote();
+        promote();
+    }
+    if (reserve.size() > max_reserve) {
+        reserve.truncate_top(max_reserve);
+        reserve_complete = false;
+    }
+}
+
 void limit_manager_t::commit(
     rwlock_in_line_t *spot,
     const boost::variant<primary_ref_t, sindex_ref_t> &sindex_ref) THROWS_NOTHING {
@@ -1123,14 +1389,17 @@ void limit_manager_t::commit(
         return;
     }
 
-    // Before we delete anything, we get the boundary between the active set and
-    // the data that didn't make it into the set.  Anything <= that according to
-    // our ordering could never be kicked out of the set because of a read from
-    // disk.
-    optional<item_t> active_boundary;
-    auto item_queue_it = item_queue.begin();
-    if (item_queue_it != item_queue.end()) {
-        active_boundary.set(**item_queue_it);
+    // Before we delete anything, we get the boundary between the rows we have in
+    // memory and the data that didn't make it into memory.  Anything <= that
+    // according to our ordering could never be kicked out of the set because of
+    // a read from disk.
+    optional<item_t> boundary;
+    if (!reserve_complete) {
+        const item_queue_t *last = reserve.size() != 0 ? &reserve : &item_queue;
+        auto last_it = last->begin();
+        if (last_it != last->end()) {
+            boundary.set(**last_it);
+        }
     }
 
     item_queue_t real_added(gt);
@@ -1140,6 +1409,8 @@ void limit_manager_t::commit(
         if (data_deleted) {
             bool inserted = real_deleted.insert(id).second;
             guarantee(inserted);
+        } else {
+            UNUSED bool reserve_deleted = reserve.del_id(id);
         }
     }
     deleted.clear();
@@ -1149,7 +1420,7 @@ void limit_manager_t::commit(
         // off of disk below.  This is fine because if the resulting set is
         // still too small, and the things we didn't add happen to beat the
         // other things in the table, we'll read them first.
-        if (!(active_boundary && gt(item_t(pair), *active_boundary))) {
+        if (!(boundary && gt(item_t(pair), *boundary))) {
             bool inserted = item_queue.insert(pair).second;
             // We can never get two additions for the same key without a deletion
             // in-between.
@@ -1162,23 +1433,20 @@ void limit_manager_t::commit(
     }
     added.clear();
 
-    std::vector<std::string> truncated = item_queue.truncate_top(spec.limit);
-    for (auto &&id : truncated) {
-        auto it = real_added.find_id(id);
-        if (it != real_added.end()) {
-            real_added.erase(it);
-        } else {
-            bool inserted = real_deleted.insert(std::move(id)).second;
-            guarantee(inserted);
-        }
-    }
+    // Rows that are pushed out of the limit go to `reserve`, and rows from
+    // `reserve` replace the ones that were deleted.
+    rebalance(&real_added, &real_deleted);
 
     bool anything_on_disk = real_deleted.size() != 0 || added_on_disk;
-    if (item_queue.size() < spec.limit && anything_on_disk) {
+    if (item_queue.size() < spec.limit && !reserve_complete && anything_on_disk) {
+        guarantee(reserve.size() == 0);
+        // We read enough to refill `reserve` as well, so that the following
+        // deletions don't have to read from disk again.
+        size_t n = spec.limit - item_queue.size() + max_reserve;
         std::vector<item_t> s;
         optional<exc_t> exc;
         try {
-            s = read_more(sindex_ref, active_boundary);
+            s = read_more(sindex_ref, boundary, n);
         } catch (const exc_t &e) {
             exc.set(e);
         }
@@ -1188,26 +1456,18 @@ void limit_manager_t::commit(
             abort(*exc);
             return;
         }
+        if (s.size() < n) {
+            reserve_complete = true;
+        }
         for (auto &&pair : s) {
-            bool inserted = item_queue.insert(pair).second;
             // Reading duplicates from disk is fine.
-            if (inserted) {
-                bool added_insert = real_added.insert(pair).second;
-                guarantee(added_insert);
+            if (item_queue.find_id(pair.first) == item_queue.end()) {
+                UNUSED bool inserted = reserve.insert(pair).second;
             }
         }
-        // We need to truncate again because `read_more` may read too much in
+        // We need to truncate `reserve` because `read_more` may read too much in
         // the secondary index case.
-        std::vector<std::string> read_trunc = item_queue.truncate_top(spec.limit);
-        for (auto &&id : read_trunc) {
-            auto it = real_added.find_id(id);
-            if (it != real_added.end()) {
-                real_added.erase(it);
-            } else {
-                bool inserted = real_deleted.insert(std::move(id)).second;
-                guarantee(inserted);
-            }
-        }
+        rebalance(&real_added, &real_deleted);
     }
     std::set<std::string> remaining_deleted;
     for (auto &&id : real_deleted) {
@@ -1390,6 +1650,10 @@ protected:
     // an error object to the user with the number of skipped elements before
     // continuing.
     size_t skipped;
+    // If the server runs low on memory for queued changes, we start squashing a
+    // subscription that wasn't asked to squash.  We set this when that happens so
+    // that we can send an error object to the user before any more changes.
+    bool squashed_under_pressure;
     feed_t *feed; // The feed we're subscribed to.
     const configured_limits_t limits;
     const bool squash; // Whether or not to squash changes.
@@ -1541,6 +1805,8 @@ public:
     template<class... Args>
     explicit flat_sub_t(init_squashing_queue_t init_squashing_queue, Args &&... args)
         : subscription_t(std::forward<Args>(args)...),
+          may_squash_under_pressure(
+              init_squashing_queue == init_squashing_queue_t::YES),
           last_stamp(std::make_pair(nil_uuid(), std::numeric_limits<uint64_t>::max())) {
         if (init_squashing_queue == init_squashing_queue_t::YES && squash) {
             queue = make_scoped<squashing_queue_t>();
@@ -1548,13 +1814,17 @@ public:
             queue = make_scoped<nonsquashing_queue_t>();
         }
     }
+    // `old_val_size` and `new_val_size` are the `queued_datum_size`s of the values,
+    // or 0 if they're missing.
     virtual void add_el(
         const uuid_u &shard_uuid,
         uint64_t stamp,
         const store_key_t &pkey,
         const optional<std::string> &DEBUG_ONLY(sindex),
         optional<indexed_datum_t> old_val,
-        optional<indexed_datum_t> new_val) {
+        optional<indexed_datum_t> new_val,
+        size_t old_val_size,
+        size_t new_val_size) {
         if (!active()) return;
         auto stamp_pair = std::make_pair(shard_uuid, stamp);
         if (stamp_pair == last_stamp || update_stamp(shard_uuid, stamp)) {
@@ -1563,11 +1833,25 @@ public:
             // like `.get_all(1, 1)`).
             last_stamp = stamp_pair;
             queue->add(change_val_t(
-                std::make_pair(shard_uuid, stamp),
-                pkey,
-                std::move(old_val),
-                std::move(new_val)
-                DEBUG_ONLY(, sindex)));
+                           std::make_pair(shard_uuid, stamp),
+                           pkey,
+                           std::move(old_val),
+                           std::move(new_val)
+                           DEBUG_ONLY(, sindex)),
+                       old_val_size,
+                       new_val_size);
+            if (!queue->is_squashing()
+                && may_squash_under_pressure
+                && changefeed_memory_budget_exceeded()) {
+                // The server is running out of memory for queued changes, so we
+                // only keep the latest change to each row, as if `squash` was
+                // set.  This is better than running out of memory, or than
+                // dropping the whole queue once it's full.  `get_els` tells the
+                // user about it.
+                squash_queue();
+                squashed_under_pressure = true;
+                ++pm_changefeed_squashed_subscriptions;
+            }
             if (queue->size() > limits.changefeed_queue_size()) {
                 skipped += queue->size();
                 queue->clear();
@@ -1589,8 +1873,19 @@ public:
     const change_val_t &peek_change_val() { return queue->peek(); }
     bool active() { return !exc; }
 protected:
+    void squash_queue() {
+        scoped_ptr_t<maybe_squashing_queue_t> old_queue = std::move(queue);
+        queue = make_scoped<squashing_queue_t>();
+        while (old_queue->size() != 0) {
+            queue->add_queued(old_queue->pop_queued());
+        }
+    }
+
     // The queue of changes we've accumulated since the last time we were read from.
     scoped_ptr_t<maybe_squashing_queue_t> queue;
+    // Whether we may switch to a squashing queue if the server runs low on memory.
+    // This isn't possible while the queue still needs to be purged.
+    bool may_squash_under_pressure;
 private:
     std::pair<uuid_u, uint64_t> last_stamp;
     virtual void apply_queued_changes() { } // Changes are never queued.
@@ -1632,6 +1927,16 @@ public:
         const auto_drainer_t::lock_t &lock,
         const std::function<void(limit_sub_t *)> &f) THROWS_NOTHING;
 
+    // Returns the start stamp and the value of `key` for a point sub that has
+    // already been added with `add_point_sub`.  Concurrent calls for the same key
+    // on the same thread share a single read.
+    changefeed_point_stamp_response_t read_point_stamp(
+        namespace_interface_t *nif,
+        const auth::user_context_t &user_context,
+        const client_t::addr_t &addr,
+        const store_key_t &key,
+        signal_t *interruptor);
+
     bool can_be_removed();
 
     virtual void abort_feed() = 0;
@@ -1700,6 +2005,23 @@ private:
     // every sub do a thread switch to read the value.
     one_per_thread_t<stamps_t> stamps;
 
+    // A point stamp read is only valid for subs that were added before it was
+    // issued, so subs that show up while one is in flight wait for it and then
+    // share the next one.
+    class point_stamp_read_t : public single_threaded_countable_t<point_stamp_read_t> {
+    public:
+        point_stamp_read_t() : issued(false), waiters(0) { }
+        bool issued;
+        int64_t waiters;
+        cond_t done;
+        // Unset if the read failed.
+        optional<changefeed_point_stamp_response_t> resp;
+    };
+    struct point_stamp_reads_t {
+        std::map<store_key_t, counted_t<point_stamp_read_t> > in_flight, next;
+    };
+    one_per_thread_t<point_stamp_reads_t> point_stamp_reads;
+
     namespace_id_t table_id;
     name_resolver_t const &name_resolver;
 };
@@ -1712,7 +2034,8 @@ void feed_t::update_stamps(uuid_u server_uuid, uint64_t stamp) {
              rwlock_acq_t acq(&rs->lock, access_t::write);
              rassert(stamp >= rs->latest[server_uuid]);
              rs->latest[server_uuid] = stamp;
-         });
+         },
+         coro_stack_size_t::SMALL);
 }
 
 // We have to return by value here because we release the lock right away.
@@ -2059,19 +2382,15 @@ public:
             state = state_t::READY;
         }
 
-        read_response_t read_resp;
-        nif->read(
+        changefeed_point_stamp_response_t res = feed->read_point_stamp(
+            nif,
             env->get_user_context(),
-            read_t(changefeed_point_stamp_t{addr, store_key_t(pkey.print_primary())},
-                   profile_bool_t::DONT_PROFILE, read_mode_t::SINGLE),
-            &read_resp,
-            order_token_t::ignore,
+            addr,
+            store_key_t(pkey.print_primary()),
             env->interruptor);
-        auto *res = boost::get<changefeed_point_stamp_response_t>(&read_resp.response);
-        guarantee(res != nullptr);
-        rcheck_datum(res->resp.has_value(), base_exc_t::RESUMABLE_OP_FAILED,
+        rcheck_datum(res.resp.has_value(), base_exc_t::RESUMABLE_OP_FAILED,
                      "Unable to retrieve start stamp.  (Did you just reshard?)");
-        auto *resp = &*res->resp;
+        auto *resp = &*res.resp;
         uint64_t start_stamp = resp->stamp.second;
         initial_val.set(change_val_t(
                resp->stamp,
@@ -2155,6 +2474,39 @@ counted_t<splice_stream_t> make_splice_stream(Args &&...args) {
     return make_counted<splice_stream_t>(std::forward<Args>(args)...);
 }
 
+// The combined deterministic-ness of the functions in a changefeed transform.
+class transform_determinism_visitor_t
+    : public boost::static_visitor<deterministic_t> {
+public:
+    deterministic_t operator()(const map_wire_func_t &f) const {
+        return f.compile_wire_func()->is_deterministic();
+    }
+    deterministic_t operator()(const group_wire_func_t &f) const {
+        deterministic_t res = deterministic_t::always();
+        for (const auto &func : f.compile_funcs()) {
+            res = res.join(func->is_deterministic());
+        }
+        return res;
+    }
+    deterministic_t operator()(const filter_wire_func_t &f) const {
+        deterministic_t res = f.filter_func.compile_wire_func()->is_deterministic();
+        if (f.default_filter_val.has_value()) {
+            res = res.join(
+                f.default_filter_val->compile_wire_func()->is_deterministic());
+        }
+        return res;
+    }
+    deterministic_t operator()(const concatmap_wire_func_t &f) const {
+        return f.compile_wire_func()->is_deterministic();
+    }
+    deterministic_t operator()(const distinct_wire_func_t &) const {
+        return deterministic_t::always();
+    }
+    deterministic_t operator()(const zip_wire_func_t &) const {
+        return deterministic_t::always();
+    }
+};
+
 class range_sub_t : public flat_sub_t {
 public:
     // Throws QL exceptions.
@@ -2185,6 +2537,7 @@ public:
         for (const auto &transform : spec.transforms) {
             ops.push_back(make_op(transform));
         }
+        ops_signature = make_ops_signature(outer_env);
         store_keys = spec.datumspec.primary_key_map();
         if (!store_keys.has_value()) {
             store_key_range.set(spec.datumspec.covering_range().to_primary_keyrange());
@@ -2223,6 +2576,46 @@ public:
     }
 
     bool has_ops() { return ops.size() != 0; }
+    const std::string &get_ops_signature() const { return ops_signature; }
+
+    void add_el(
+        const uuid_u &shard_uuid,
+        uint64_t stamp,
+        const store_key_t &pkey,
+        const optional<std::string> &sindex,
+        optional<indexed_datum_t> old_val,
+        optional<indexed_datum_t> new_val,
+        size_t old_val_size,
+        size_t new_val_size) final {
+        // Changes to keys that the initial read hasn't reached yet are going to
+        // be discarded by the `splice_stream_t` (the read will see them), so
+        // there's no need to keep their values around.  We still have to queue
+        // the changes themselves for their stamps.
+        if (unread_fenceposts.size() != 0) {
+            bool strip_old = old_val && is_unread(shard_uuid, pkey, *old_val);
+            bool strip_new = new_val && is_unread(shard_uuid, pkey, *new_val);
+            if (strip_old) {
+                old_val->val = datum_t::null();
+                old_val_size = 0;
+                if (strip_new) {
+                    new_val.reset();
+                    new_val_size = 0;
+                }
+            } else if (strip_new) {
+                new_val->val = datum_t::null();
+                new_val_size = 0;
+            }
+        }
+        flat_sub_t::add_el(shard_uuid, stamp, pkey, sindex,
+                           std::move(old_val), std::move(new_val),
+                           old_val_size, new_val_size);
+    }
+    // Called by the `splice_stream_t` whenever it isn't reading, with the key of
+    // each shard from which on nothing has been read yet.  Called with an empty
+    // map before it starts reading.
+    void set_unread_fenceposts(std::map<uuid_u, store_key_t> &&fenceposts) {
+        unread_fenceposts = std::move(fenceposts);
+    }
 
     optional<datum_t> apply_ops(datum_t val) {
         guarantee(active());
@@ -2285,12 +2678,9 @@ public:
 
     void maybe_enable_squashing() {
         if (squash) {
-            scoped_ptr_t<maybe_squashing_queue_t> old_queue = std::move(queue);
-            queue = make_scoped<squashing_queue_t>();
-            while (old_queue->size() != 0) {
-                queue->add(old_queue->pop());
-            }
+            squash_queue();
         }
+        may_squash_under_pressure = true;
     }
 
     counted_t<datum_stream_t> to_stream(
@@ -2396,8 +2786,55 @@ private:
                 nullptr/*don't profile*/);
     }
 
+    std::string make_ops_signature(env_t *outer_env) {
+        if (!has_ops() || outer_env->get_rdb_ctx() == nullptr) {
+            return std::string();
+        }
+        deterministic_t det = deterministic_t::always();
+        for (const auto &transform : spec.transforms) {
+            det = det.join(
+                boost::apply_visitor(transform_determinism_visitor_t(), transform));
+        }
+        if (!det.test(single_server_t::yes, constant_now_t::yes)) {
+            // Transforms using e.g. `r.random()` or `r.js()` can give different
+            // results in every subscription, so we never share them.
+            return std::string();
+        }
+        serializable_env_t s_env = outer_env->get_serializable_env();
+        if (det.test(single_server_t::yes, constant_now_t::no)) {
+            s_env.deterministic_time = datum_t::null();
+        }
+        write_message_t wm;
+        serialize<cluster_version_t::CLUSTER>(&wm, spec.transforms);
+        serialize<cluster_version_t::CLUSTER>(&wm, s_env);
+        vector_stream_t stream;
+        stream.reserve(wm.size());
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+        return std::string(stream.vector().begin(), stream.vector().end());
+    }
+
     scoped_ptr_t<env_t> env;
     std::vector<scoped_ptr_t<op_t> > ops;
+    bool is_unread(const uuid_u &shard_uuid,
+                   const store_key_t &pkey,
+                   const indexed_datum_t &val) const {
+        auto it = unread_fenceposts.find(shard_uuid);
+        if (it == unread_fenceposts.end()) {
+            return false;
+        }
+        return val.btree_index_key
+            ? store_key_t(*val.btree_index_key) >= it->second
+            : pkey >= it->second;
+    }
+    std::map<uuid_u, store_key_t> unread_fenceposts;
+
+    // Subscriptions with the same (non-empty) signature get the same results from
+    // applying their `ops` to a change, so `msg_visitor_t` only evaluates them
+    // once.  That's the case if they have the same deterministic transforms and
+    // environment, ignoring the time the query was started at unless `r.now()` is
+    // used.
+    std::string ops_signature;
 
     // The stamp (see `stamped_msg_t`) associated with our `changefeed_stamp_t`
     // read.  We use these to make sure we don't see changes from writes before
@@ -2837,24 +3274,52 @@ public:
     }
     void operator()(const msg_t::change_t &change) const {
         datum_t null = datum_t::null();
-
+        // The sizes of the values for the subscription queues, computed once for
+        // all subscriptions.
+        const size_t change_old_size = queued_datum_size(change.old_val);
+        const size_t change_new_size = queued_datum_size(change.new_val);
+
+        // The transformed values of subscriptions with identical transforms, by
+        // thread and signature.  Each thread only touches its own map.
+        std::vector<std::map<std::string, transformed_vals_t> >
+            transformed(get_num_threads());
         feed->each_range_sub(*lock, [&](range_sub_t *sub) {
             datum_t new_val = null, old_val = null;
+            size_t new_size = 0, old_size = 0;
             if (!sub->active()) return;
             bool trivial = false;
             if (sub->has_ops()) {
-                if (change.new_val.has()) {
-                    if (optional<datum_t> d = sub->apply_ops(change.new_val)) {
-                        new_val = *d;
+                const std::string &signature = sub->get_ops_signature();
+                auto *cache = &transformed[get_thread_id().threadnum];
+                auto cached = signature.empty() ? cache->end() : cache->find(signature);
+                if (cached != cache->end()) {
+                    new_val = cached->second.new_val;
+                    old_val = cached->second.old_val;
+                    new_size = cached->second.new_size;
+                    old_size = cached->second.old_size;
+                } else {
+                    if (change.new_val.has()) {
+                        if (optional<datum_t> d = sub->apply_ops(change.new_val)) {
+                            new_val = *d;
+                        }
                     }
-                }
-                if (!sub->active()) return;
-                if (change.old_val.has()) {
-                    if (optional<datum_t> d = sub->apply_ops(change.old_val)) {
-                        old_val = *d;
+                    if (!sub->active()) return;
+                    if (change.old_val.has()) {
+                        if (optional<datum_t> d = sub->apply_ops(change.old_val)) {
+                            old_val = *d;
+                        }
+                    }
+                    if (!sub->active()) return;
+                    new_size = queued_datum_size(new_val);
+                    old_size = queued_datum_size(old_val);
+                    if (!signature.empty()) {
+                        transformed_vals_t *vals = &(*cache)[signature];
+                        vals->new_val = new_val;
+                        vals->old_val = old_val;
+                        vals->new_size = new_size;
+                        vals->old_size = old_size;
                     }
                 }
-                if (!sub->active()) return;
                 // Duplicate values are caught before being written to disk and
                 // don't generate a `mod_report`, but if we have transforms the
                 // values might have changed.
@@ -2863,9 +3328,11 @@ public:
                 guarantee(change.old_val.has() || change.new_val.has());
                 if (change.new_val.has()) {
                     new_val = change.new_val;
+                    new_size = change_new_size;
                 }
                 if (change.old_val.has()) {
                     old_val = change.old_val;
+                    old_size = change_old_size;
                 }
             }
             ASSERT_NO_CORO_WAITING;
@@ -2894,7 +3361,8 @@ public:
                     if (!trivial) {
                         sub->add_el(server_uuid, stamp, change.pkey, sindex,
                                     make_optional(std::move(old_idxs.back())),
-                                    make_optional(std::move(new_idxs.back())));
+                                    make_optional(std::move(new_idxs.back())),
+                                    old_size, new_size);
                     }
                     old_idxs.pop_back();
                     new_idxs.pop_back();
@@ -2904,7 +3372,8 @@ public:
                     if (old_val != null) {
                         sub->add_el(server_uuid, stamp, change.pkey, sindex,
                                     make_optional(std::move(old_idxs.back())),
-                                    r_nullopt);
+                                    r_nullopt,
+                                    old_size, 0);
                     }
                     old_idxs.pop_back();
                 }
@@ -2913,7 +3382,8 @@ public:
                     if (new_val != null) {
                         sub->add_el(server_uuid, stamp, change.pkey, sindex,
                                     r_nullopt,
-                                    make_optional(std::move(new_idxs.back())));
+                                    make_optional(std::move(new_idxs.back())),
+                                    0, new_size);
                     }
                     new_idxs.pop_back();
                 }
@@ -2922,7 +3392,8 @@ public:
                     for (size_t i = 0; i < sub->copies(change.pkey); ++i) {
                         sub->add_el(server_uuid, stamp, change.pkey, sindex,
                                     make_optional(indexed_datum_t(old_val, r_nullopt)),
-                                    make_optional(indexed_datum_t(new_val, r_nullopt)));
+                                    make_optional(indexed_datum_t(new_val, r_nullopt)),
+                                    old_size, new_size);
                     }
                 }
             }
@@ -2939,13 +3410,20 @@ public:
                             change.new_val.has()
                                 ? optional<indexed_datum_t>(
                                         indexed_datum_t(change.new_val, r_nullopt))
-                                : r_nullopt);
+                                : r_nullopt,
+                            change_old_size,
+                            change_new_size);
             });
     }
     void operator()(const msg_t::stop_t &) const {
         feed->abort_feed();
     }
 private:
+    struct transformed_vals_t {
+        datum_t new_val, old_val;
+        size_t new_size, old_size;
+    };
+
     feed_t *feed;
     const auto_drainer_t::lock_t *lock;
     uuid_u server_uuid;
@@ -3017,6 +3495,7 @@ public:
         for (const auto &p : sub->get_orig_stamps()) {
             stamped_ranges.insert(std::make_pair(p.first, stamped_range_t(p.second)));
         }
+        note_unread_ranges();
     }
 
 private:
@@ -3069,8 +3548,12 @@ private:
             if (!src->is_exhausted() && !batcher.should_send_batch()) {
                 // Sorting must be UNORDERED for our last_read range calculation to work.
                 batchspec_t new_bs = bs.with_lazy_sorting_override(sorting_t::UNORDERED);
+                // Changes that arrive while we're reading may or may not be seen
+                // by the read.
+                sub->set_unread_fenceposts(std::map<uuid_u, store_key_t>());
                 std::vector<datum_t> batch = src->next_batch(env, new_bs);
                 update_ranges();
+                note_unread_ranges();
                 r_sanity_check(active_state);
                 read_once = true;
                 if (batch.size() == 0) {
@@ -3152,6 +3635,17 @@ private:
         }
     }
 
+    void note_unread_ranges() {
+        std::map<uuid_u, store_key_t> fenceposts;
+        if (!src->is_exhausted()) {
+            for (auto &&pair : stamped_ranges) {
+                fenceposts.insert(
+                    std::make_pair(pair.first, pair.second.get_right_fencepost()));
+            }
+        }
+        sub->set_unread_fenceposts(std::move(fenceposts));
+    }
+
     void update_ranges() {
         active_state = src->get_active_state();
         r_sanity_check(active_state);
@@ -3230,6 +3724,7 @@ subscription_t::subscription_t(
     bool _include_states,
     bool _include_types)
     : skipped(0),
+      squashed_under_pressure(false),
       feed(_feed),
       limits(std::move(_limits)),
       squash(_squash.as_bool()),
@@ -3330,6 +3825,15 @@ subscription_t::get_els(batcher_t *batcher,
                                 strprintf("Changefeed cache over array size limit, "
                                           "skipped %zu elements.", skipped)))}}));
         skipped = 0;
+    } else if (squashed_under_pressure) {
+        ret.push_back(
+            datum_t(
+                std::map<datum_string_t, datum_t>{
+                    {datum_string_t("error"), datum_t(
+                            datum_string_t(
+                                "Changefeed queues over server memory budget, "
+                                "squashing changes to the same document."))}}));
+        squashed_under_pressure = false;
     } else if (has_el()) {
         while (has_el() && !batcher->should_send_batch(ignore_latency_t::YES)) {
             datum_t el = pop_el();
@@ -3732,6 +4236,87 @@ feed_t::feed_t(
     table_id(_table_id),
     name_resolver(_name_resolver) { }
 
+changefeed_point_stamp_response_t do_read_point_stamp(
+        namespace_interface_t *nif,
+        const auth::user_context_t &user_context,
+        const client_t::addr_t &addr,
+        const store_key_t &key,
+        signal_t *interruptor) {
+    read_response_t read_resp;
+    nif->read(
+        user_context,
+        read_t(changefeed_point_stamp_t{addr, key},
+               profile_bool_t::DONT_PROFILE, read_mode_t::SINGLE),
+        &read_resp,
+        order_token_t::ignore,
+        interruptor);
+    auto *res = boost::get<changefeed_point_stamp_response_t>(&read_resp.response);
+    guarantee(res != nullptr);
+    return std::move(*res);
+}
+
+changefeed_point_stamp_response_t feed_t::read_point_stamp(
+        namespace_interface_t *nif,
+        const auth::user_context_t &user_context,
+        const client_t::addr_t &addr,
+        const store_key_t &key,
+        signal_t *interruptor) {
+    point_stamp_reads_t *reads = point_stamp_reads.get();
+    counted_t<point_stamp_read_t> read;
+    auto next_it = reads->next.find(key);
+    if (next_it != reads->next.end()) {
+        read = next_it->second;
+    } else {
+        read = make_counted<point_stamp_read_t>();
+        reads->next[key] = read;
+    }
+
+    read->waiters += 1;
+    try {
+        for (;;) {
+            auto it = reads->in_flight.find(key);
+            if (read->issued || it == reads->in_flight.end()) {
+                break;
+            }
+            counted_t<point_stamp_read_t> other = it->second;
+            wait_interruptible(&other->done, interruptor);
+        }
+    } catch (const interrupted_exc_t &) {
+        read->waiters -= 1;
+        if (!read->issued && read->waiters == 0) {
+            reads->next.erase(key);
+        }
+        throw;
+    }
+    read->waiters -= 1;
+
+    if (!read->issued) {
+        read->issued = true;
+        reads->next.erase(key);
+        reads->in_flight[key] = read;
+        try {
+            read->resp.set(
+                do_read_point_stamp(nif, user_context, addr, key, interruptor));
+        } catch (...) {
+            reads->in_flight.erase(key);
+            read->done.pulse();
+            throw;
+        }
+        reads->in_flight.erase(key);
+        read->done.pulse();
+        return *read->resp;
+    }
+
+    wait_interruptible(&read->done, interruptor);
+    if (read->resp.has_value()) {
+        return *read->resp;
+    } else {
+        // The read we were waiting for failed, probably because its query was
+        // interrupted, so we do our own.
+        return do_read_point_stamp(nif, user_context, addr, key, interruptor);
+    }
+}
+
 feed_t::~feed_t() {
     guarantee(num_subs == 0);
     guarantee(detached);
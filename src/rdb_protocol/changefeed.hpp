@@ -6,6 +6,7 @@
 #include <exception>
 #include <functional>
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 #include <utility>
@@ -433,10 +434,16 @@ public:
     const optional<uuid_u> sindex_id;
     const uuid_u uuid;
 private:
-    // Can throw `exc_t` exceptions if an error occurs while reading from disk.
+    // Reads up to `n` rows that come after `start` (or from the beginning).  Can
+    // throw `exc_t` exceptions if an error occurs while reading from disk.
     std::vector<item_t> read_more(
         const boost::variant<primary_ref_t, sindex_ref_t> &ref,
-        const optional<item_t> &start);
+        const optional<item_t> &start,
+        size_t n);
+    // Moves rows between `item_queue` and `reserve` until `item_queue` holds
+    // `spec.limit` rows or `reserve` is empty, and records which rows entered or
+    // left `item_queue`.
+    void rebalance(item_queue_t *real_added, std::set<std::string> *real_deleted);
     void send(msg_t &&msg);
 
     scoped_ptr_t<env_t> env;
@@ -449,6 +456,13 @@ private:
 
     limit_order_t gt;
     item_queue_t item_queue;
+    // The rows that come right after `item_queue`, so that rows which drop out of
+    // `item_queue` can usually be replaced without reading from disk.  Together
+    // with `item_queue` these are always the first rows of the range.
+    item_queue_t reserve;
+    size_t max_reserve;
+    // Whether `item_queue` and `reserve` hold every row of the range.
+    bool reserve_complete;
 
     std::map<std::string, std::pair<datum_t, datum_t> > added;
     std::set<std::string> deleted;
@@ -541,6 +555,17 @@ private:
     };
     std::map<client_t::addr_t, client_info_t> clients;
 
+    // Indexes `clients` by the key ranges of their regions, so that `send_all`
+    // only looks at the clients that may be interested in a key.  Each entry
+    // covers the keys from its own key up to the key of the next entry, and lists
+    // the clients (along with their regions, which may still exclude a key by its
+    // hash) whose regions overlap that range.  Must be rebuilt with a write lock
+    // on `clients_lock` whenever `clients` or their regions change.
+    typedef std::pair<std::pair<const client_t::addr_t, client_info_t> *,
+                      const region_t *> indexed_client_t;
+    std::map<store_key_t, std::vector<indexed_client_t> > client_index;
+    void rebuild_client_index();
+
     void prune_dead_limit(
         auto_drainer_t::lock_t *stealable_lock,
         scoped_ptr_t<rwlock_in_line_t> *stealable_clients_read_lock,
@@ -8,6 +8,7 @@
 #include "rdb_protocol/datum_stream/array.hpp"
 #include "rdb_protocol/datum_stream/eq_join.hpp"
 #include "rdb_protocol/datum_stream/fold.hpp"
+#include "rdb_protocol/datum_stream/hash_join.hpp"
 #include "rdb_protocol/datum_stream/indexed_sort.hpp"
 #include "rdb_protocol/datum_stream/lazy.hpp"
 #include "rdb_protocol/datum_stream/map.hpp"
@@ -2407,6 +2408,183 @@ bool eq_join_datum_stream_t::is_exhausted() const {
     return false;
 }
 
+hash_join_datum_stream_t::hash_join_datum_stream_t(
+        counted_t<datum_stream_t> _left,
+        counted_t<const func_t> _left_reader,
+        bool _left_is_deterministic,
+        counted_t<datum_stream_t> _right,
+        counted_t<const func_t> _right_reader,
+        counted_t<const func_t> _left_key,
+        counted_t<const func_t> _right_key,
+        backtrace_id_t _bt) :
+    eager_datum_stream_t(_bt),
+    left(std::move(_left)),
+    left_reader(std::move(_left_reader)),
+    left_batch_pos(0),
+    left_is_deterministic(_left_is_deterministic),
+    right(std::move(_right)),
+    right_reader(std::move(_right_reader)),
+    right_exhausted(false),
+    left_key(std::move(_left_key)),
+    right_key(std::move(_right_key)),
+    chunk_loaded(false),
+    nested_loop(left->is_infinite()),
+    finished(false),
+    is_array_join(left->is_array()),
+    is_infinite_join(left->is_infinite()),
+    join_type(left->cfeed_type()) {
+    if (nested_loop) {
+        // An infinite left-hand side is never done with a chunk of the right-hand
+        // side, so we would keep the first chunk forever and never see later
+        // changes to the right-hand side.
+        right.reset();
+    }
+}
+
+std::vector<datum_t> hash_join_datum_stream_t::next_raw_batch(
+    env_t *env,
+    const batchspec_t &batchspec) {
+    batcher_t batcher = batchspec.to_batcher();
+
+    if (!chunk_loaded && is_array_join && !left_array.has()) {
+        // Arrays are cheap to read again if the right-hand side needs more than
+        // one chunk.
+        left_array = left->as_array(env);
+        if (left_array.has()) {
+            left = make_counted<array_datum_stream_t>(left_array, backtrace());
+        }
+    }
+
+    std::vector<datum_t> res;
+    while (!finished && !batcher.should_send_batch()) {
+        if (left_batch_pos == left_batch.size()) {
+            left_batch = left->next_batch(env, batchspec);
+            left_batch_pos = 0;
+            if (left_batch.empty()) {
+                if (!left->is_exhausted()) {
+                    // This is a changefeed that has nothing for us right now.
+                    break;
+                }
+                // We're done with this chunk of the right-hand side.
+                if (!chunk_loaded || nested_loop || !load_chunk(env)) {
+                    finished = true;
+                    break;
+                }
+                restart_left(env);
+                continue;
+            }
+            if (!chunk_loaded && !nested_loop) {
+                // We don't read the right-hand side until there is something to
+                // join it with.
+                chunk_loaded = true;
+                if (!load_chunk(env)) {
+                    finished = true;
+                    break;
+                }
+                if (!right_exhausted && !right->is_exhausted()
+                    && !left_array.has() && !left_is_deterministic) {
+                    // The right-hand side doesn't fit into one chunk, and reading
+                    // the left-hand side again might give different rows.
+                    chunk.clear();
+                    right.reset();
+                    nested_loop = true;
+                }
+            }
+        }
+
+        const datum_t &row = left_batch[left_batch_pos++];
+        if (nested_loop) {
+            nested_loop_join(env, row, &batcher, &res);
+            continue;
+        }
+        auto it = chunk.find(left_key->call(env, row)->as_datum());
+        if (it == chunk.end()) {
+            continue;
+        }
+        datum_string_t right_field("right");
+        datum_string_t left_field("left");
+        for (const datum_t &match : it->second) {
+            ql::datum_object_builder_t res_item;
+            bool conflict = true;
+            conflict &= res_item.add(right_field, match);
+            conflict &= res_item.add(left_field, row);
+            guarantee(!conflict);
+            datum_t res_datum = std::move(res_item).to_datum();
+            batcher.note_el(res_datum);
+            res.push_back(std::move(res_datum));
+        }
+    }
+    return res;
+}
+
+bool hash_join_datum_stream_t::load_chunk(env_t *env) {
+    chunk.clear();
+    if (right_exhausted) {
+        return false;
+    }
+    const size_t max_rows = env->limits().array_size_limit();
+    size_t rows = 0;
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::NORMAL, env);
+    while (rows < max_rows) {
+        std::vector<datum_t> batch = right->next_batch(env, batchspec);
+        if (batch.empty()) {
+            right_exhausted = true;
+            break;
+        }
+        for (auto &&row : batch) {
+            datum_t key = right_key->call(env, row)->as_datum();
+            chunk[key].push_back(std::move(row));
+            ++rows;
+        }
+    }
+    return rows != 0;
+}
+
+void hash_join_datum_stream_t::restart_left(env_t *env) {
+    if (left_array.has()) {
+        left = make_counted<array_datum_stream_t>(left_array, backtrace());
+    } else {
+        r_sanity_check(left_reader.has() && left_is_deterministic);
+        left = left_reader->call(env)->as_seq(env);
+    }
+    left_batch.clear();
+    left_batch_pos = 0;
+}
+
+void hash_join_datum_stream_t::nested_loop_join(env_t *env,
+                                                const datum_t &row,
+                                                batcher_t *batcher,
+                                                std::vector<datum_t> *out) {
+    datum_t key = left_key->call(env, row)->as_datum();
+    counted_t<datum_stream_t> stream = right_reader->call(env)->as_seq(env);
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::NORMAL, env);
+    datum_string_t right_field("right");
+    datum_string_t left_field("left");
+    for (;;) {
+        std::vector<datum_t> batch = stream->next_batch(env, batchspec);
+        if (batch.empty()) {
+            break;
+        }
+        for (const datum_t &match : batch) {
+            if (right_key->call(env, match)->as_datum() != key) {
+                continue;
+            }
+            ql::datum_object_builder_t res_item;
+            bool conflict = true;
+            conflict &= res_item.add(right_field, match);
+            conflict &= res_item.add(left_field, row);
+            guarantee(!conflict);
+            datum_t res_datum = std::move(res_item).to_datum();
+            batcher->note_el(res_datum);
+            out->push_back(std::move(res_datum));
+        }
+    }
+}
+
+bool hash_join_datum_stream_t::is_exhausted() const {
+    return finished && batch_cache_exhausted();
+}
+
 fold_datum_stream_t::fold_datum_stream_t(
     counted_t<datum_stream_t> &&_stream,
     datum_t _base,
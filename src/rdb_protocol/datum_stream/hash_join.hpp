@@ -0,0 +1,86 @@
+#ifndef RDB_PROTOCOL_DATUM_STREAM_HASH_JOIN_HPP_
+#define RDB_PROTOCOL_DATUM_STREAM_HASH_JOIN_HPP_
+
+#include <map>
+#include <vector>
+
+#include "rdb_protocol/datum_stream.hpp"
+
+namespace ql {
+
+/* Evaluates `left.inner_join(right, f)` where `f` compares a field of either row
+for equality.  Rows of the right-hand side are loaded into a table keyed by
+`right_key`, which is then probed with `left_key` of each left-hand row while the
+left-hand side is streamed.  If the right-hand side has more rows than the array
+size limit, it is loaded one chunk at a time and the left-hand side is read once
+per chunk, either from its materialized array or by calling `left_reader` again.
+Reading the left-hand side again is only correct if it is deterministic.  If it
+isn't, we fall back to a nested-loop join that reads the left-hand side once and
+evaluates `right_reader` again for every left-hand row, like the `concat_map`
+rewrite of `inner_join` does.  An infinite left-hand side, such as a changefeed,
+always uses the nested-loop join, so that each row is joined with the current
+right-hand side. */
+class hash_join_datum_stream_t : public eager_datum_stream_t {
+public:
+    hash_join_datum_stream_t(counted_t<datum_stream_t> _left,
+                             counted_t<const func_t> _left_reader,
+                             bool _left_is_deterministic,
+                             counted_t<datum_stream_t> _right,
+                             counted_t<const func_t> _right_reader,
+                             counted_t<const func_t> _left_key,
+                             counted_t<const func_t> _right_key,
+                             backtrace_id_t bt);
+
+    bool is_array() const final {
+        return is_array_join;
+    }
+    bool is_infinite() const final {
+        return is_infinite_join;
+    }
+    bool is_exhausted() const final;
+
+    std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    feed_type_t cfeed_type() const final {
+        return join_type;
+    }
+
+private:
+    // Loads the next chunk of the right-hand side.  Returns false if there was
+    // nothing left to load.
+    bool load_chunk(env_t *env);
+    void restart_left(env_t *env);
+    // Appends the joined rows for `row` to `out`, reading the whole right-hand side.
+    void nested_loop_join(env_t *env,
+                          const datum_t &row,
+                          batcher_t *batcher,
+                          std::vector<datum_t> *out);
+
+    counted_t<datum_stream_t> left;
+    counted_t<const func_t> left_reader;
+    datum_t left_array;
+    std::vector<datum_t> left_batch;
+    size_t left_batch_pos;
+    const bool left_is_deterministic;
+
+    counted_t<datum_stream_t> right;
+    counted_t<const func_t> right_reader;
+    bool right_exhausted;
+
+    counted_t<const func_t> left_key;
+    counted_t<const func_t> right_key;
+
+    std::map<datum_t, std::vector<datum_t> > chunk;
+    bool chunk_loaded;
+    bool nested_loop;
+    bool finished;
+
+    bool is_array_join;
+    bool is_infinite_join;
+    feed_type_t join_type;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_DATUM_STREAM_HASH_JOIN_HPP_
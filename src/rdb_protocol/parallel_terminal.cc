@@ -0,0 +1,296 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include "rdb_protocol/parallel_terminal.hpp"
+
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/pmap.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+#include "threading.hpp"
+
+namespace ql {
+
+// Transforms that look at neighbouring rows (`distinct`) or at the secondary index
+// value of the current row can't be evaluated on batches of rows.
+class parallel_transform_visitor_t : public boost::static_visitor<bool> {
+public:
+    bool operator()(const map_wire_func_t &) const { return true; }
+    bool operator()(const group_wire_func_t &f) const {
+        return !f.should_append_index();
+    }
+    bool operator()(const filter_wire_func_t &) const { return true; }
+    bool operator()(const concatmap_wire_func_t &) const { return true; }
+    bool operator()(const distinct_wire_func_t &) const { return false; }
+    bool operator()(const zip_wire_func_t &) const { return true; }
+};
+
+class parallel_terminal_visitor_t : public boost::static_visitor<bool> {
+public:
+    bool operator()(const count_wire_func_t &) const { return true; }
+    bool operator()(const sum_wire_func_t &) const { return true; }
+    bool operator()(const avg_wire_func_t &) const { return true; }
+    bool operator()(const min_wire_func_t &) const { return true; }
+    bool operator()(const max_wire_func_t &) const { return true; }
+    bool operator()(const reduce_wire_func_t &) const { return true; }
+    bool operator()(const limit_read_t &) const { return false; }
+};
+
+bool parallel_terminal_t::can_parallelize(
+        env_t *env,
+        const std::vector<transform_variant_t> &transforms,
+        const terminal_variant_t &terminal,
+        bool uses_val) {
+    if (get_num_db_threads() < 2 || env->get_rdb_ctx() == nullptr) {
+        return false;
+    }
+    // The helpers don't record profiler events.
+    if (env->trace != nullptr) {
+        return false;
+    }
+    // There's nothing to gain for a plain `count()`.
+    if (transforms.empty() && !uses_val) {
+        return false;
+    }
+    if (!boost::apply_visitor(parallel_terminal_visitor_t(), terminal)) {
+        return false;
+    }
+    for (const auto &transform : transforms) {
+        if (!boost::apply_visitor(parallel_transform_visitor_t(), transform)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+parallel_terminal_t::worker_t::worker_t(threadnum_t _thread, signal_t *_interruptor)
+    : thread(_thread),
+      interruptor(_interruptor, _thread),
+      pending_batches(0),
+      has_run(false) { }
+
+parallel_terminal_t::parallel_terminal_t(
+        env_t *_env,
+        const std::vector<transform_variant_t> &_transforms,
+        const terminal_variant_t &_terminal)
+    : env(_env),
+      transforms(_transforms),
+      terminal(_terminal),
+      next_worker(0),
+      in_flight(2 * std::min<int64_t>(get_num_db_threads(),
+                                      MAX_PARALLEL_TERMINAL_THREADS)) {
+    // The store's own thread is the first helper.
+    const int num_threads = get_num_db_threads();
+    const int num_workers = std::min<int>(num_threads, MAX_PARALLEL_TERMINAL_THREADS);
+    const int home = get_thread_id().threadnum;
+    for (int i = 0; i < num_workers; ++i) {
+        workers.push_back(make_scoped<worker_t>(
+            threadnum_t((home + i) % num_threads), env->interruptor));
+    }
+    batch.reserve(PARALLEL_TERMINAL_BATCH_SIZE);
+}
+
+parallel_terminal_t::~parallel_terminal_t() {
+    assert_thread();
+    drainer.drain();
+    // The state of the helpers must be destroyed on their own threads.  This has
+    // already happened unless `finish()` was skipped.
+    pmap(workers.size(), [&](int64_t i) {
+        worker_t *worker = workers[i].get();
+        if (worker->env.has()) {
+            on_thread_t rethreader(worker->thread);
+            destroy_on_worker_thread(worker);
+        }
+    });
+}
+
+void parallel_terminal_t::add_row(datum_t &&row, size_t copies)
+        THROWS_ONLY(interrupted_exc_t) {
+    assert_thread();
+    for (size_t i = 1; i < copies; ++i) {
+        batch.push_back(row);
+    }
+    batch.push_back(std::move(row));
+    if (batch.size() >= PARALLEL_TERMINAL_BATCH_SIZE) {
+        dispatch_batch();
+    }
+}
+
+parallel_terminal_t::worker_t *parallel_terminal_t::choose_worker() {
+    // A helper thread that is busy with other work falls behind on its batches, so
+    // the remaining batches go to the helpers that keep up.  Workers with the same
+    // number of pending batches are used in turn.
+    size_t chosen = next_worker;
+    for (size_t i = 1; i < workers.size(); ++i) {
+        size_t candidate = (next_worker + i) % workers.size();
+        if (workers[candidate]->pending_batches < workers[chosen]->pending_batches) {
+            chosen = candidate;
+        }
+    }
+    next_worker = (chosen + 1) % workers.size();
+    return workers[chosen].get();
+}
+
+void parallel_terminal_t::dispatch_batch() THROWS_ONLY(interrupted_exc_t) {
+    new_semaphore_in_line_t in_flight_acq(&in_flight, 1);
+    wait_interruptible(in_flight_acq.acquisition_signal(), env->interruptor);
+
+    worker_t *worker = choose_worker();
+    ++worker->pending_batches;
+
+    datums_t to_process;
+    to_process.reserve(PARALLEL_TERMINAL_BATCH_SIZE);
+    to_process.swap(batch);
+    coro_t::spawn_sometime(std::bind(&parallel_terminal_t::process_batch,
+                                     this,
+                                     worker,
+                                     std::move(to_process),
+                                     std::move(in_flight_acq),
+                                     auto_drainer_t::lock_t(&drainer)));
+}
+
+void parallel_terminal_t::process_batch(
+        worker_t *worker,
+        datums_t &to_process,
+        UNUSED new_semaphore_in_line_t &in_flight_acq,
+        auto_drainer_t::lock_t keepalive) {
+    try {
+        new_mutex_in_line_t mutex_lock(&worker->mutex);
+        wait_interruptible(mutex_lock.acq_signal(), keepalive.get_drain_signal());
+        if (!error.has_value()) {
+            {
+                on_thread_t rethreader(worker->thread);
+                run_on_worker_thread(worker, &to_process);
+            }
+            if (!error.has_value()) {
+                if (exc_t *e = boost::get<exc_t>(&worker->result)) {
+                    error.set(*e);
+                }
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        // The traversal is being torn down, so the result doesn't matter.
+    }
+    assert_thread();
+    guarantee(worker->pending_batches > 0);
+    --worker->pending_batches;
+}
+
+void parallel_terminal_t::run_on_worker_thread(worker_t *worker, datums_t *rows) {
+    // A previous batch may have failed, in which case we don't bother.
+    if (boost::get<exc_t>(&worker->result) != nullptr) {
+        return;
+    }
+    try {
+        if (!worker->env.has()) {
+            guarantee(!worker->has_run);
+            worker->has_run = true;
+            worker->env.init(new env_t(env->get_rdb_ctx(),
+                                       env->return_empty_normal_batches,
+                                       &worker->interruptor,
+                                       env->get_serializable_env(),
+                                       nullptr));
+            for (const auto &transform : transforms) {
+                worker->transformers.push_back(make_op(transform));
+            }
+            worker->accumulator = make_terminal(terminal);
+        }
+
+        groups_t data = {{datum_t(), std::move(*rows)}};
+        // Rows of a primary index traversal have no secondary index value.
+        auto no_sindex_val = []() -> datum_t { return datum_t(); };
+        for (auto &transformer : worker->transformers) {
+            (*transformer)(worker->env.get(), &data, no_sindex_val);
+        }
+        // Terminals don't care about the key.
+        (*worker->accumulator)(worker->env.get(), &data, store_key_t(), no_sindex_val);
+    } catch (const exc_t &e) {
+        worker->result = e;
+    } catch (const datum_exc_t &e) {
+        worker->result = exc_t(e, backtrace_id_t::empty());
+    } catch (const interrupted_exc_t &) {
+        // The query's interruptor fired, which `finish()` is going to notice.
+    }
+}
+
+void parallel_terminal_t::finish(accumulator_t *accumulator,
+                                 continue_bool_t last_cb,
+                                 result_t *out) THROWS_ONLY(interrupted_exc_t) {
+    assert_thread();
+    bool interrupted = false;
+    if (!batch.empty() && !error.has_value()) {
+        try {
+            dispatch_batch();
+        } catch (const interrupted_exc_t &) {
+            // We must still wait for the helpers before we rethrow.
+            interrupted = true;
+        }
+    }
+
+    // Acquiring the whole semaphore waits for all outstanding batches.  This doesn't
+    // take long even if the query was interrupted, because the helpers are
+    // interrupted as well.
+    {
+        new_semaphore_in_line_t all_acq(&in_flight, in_flight.capacity());
+        all_acq.acquisition_signal()->wait();
+    }
+
+    pmap(workers.size(), [&](int64_t i) {
+        finish_on_worker_thread(workers[i].get());
+    });
+
+    // A helper that was interrupted dropped the rest of its batch, so the partial
+    // results may be incomplete.
+    if (interrupted || env->interruptor->is_pulsed()) {
+        throw interrupted_exc_t();
+    }
+
+    if (error.has_value()) {
+        *out = *error;
+        return;
+    }
+
+    std::vector<result_t *> results;
+    for (const auto &worker : workers) {
+        if (exc_t *e = boost::get<exc_t>(&worker->result)) {
+            *out = *e;
+            return;
+        }
+        if (worker->has_run) {
+            results.push_back(&worker->result);
+        }
+    }
+
+    try {
+        if (!results.empty()) {
+            accumulator->unshard(env, results);
+        }
+    } catch (const exc_t &e) {
+        *out = e;
+        return;
+    } catch (const datum_exc_t &e) {
+        *out = exc_t(e, backtrace_id_t::empty());
+        return;
+    }
+    accumulator->finish(last_cb, out);
+}
+
+void parallel_terminal_t::finish_on_worker_thread(worker_t *worker) {
+    if (!worker->env.has()) {
+        return;
+    }
+    on_thread_t rethreader(worker->thread);
+    if (boost::get<exc_t>(&worker->result) == nullptr) {
+        worker->accumulator->finish(continue_bool_t::CONTINUE, &worker->result);
+    }
+    destroy_on_worker_thread(worker);
+}
+
+void parallel_terminal_t::destroy_on_worker_thread(worker_t *worker) {
+    guarantee(get_thread_id() == worker->thread);
+    worker->accumulator.reset();
+    worker->transformers.clear();
+    worker->env.reset();
+}
+
+}  // namespace ql
@@ -0,0 +1,107 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_PARALLEL_TERMINAL_HPP_
+#define RDB_PROTOCOL_PARALLEL_TERMINAL_HPP_
+
+#include <vector>
+
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/new_mutex.hpp"
+#include "concurrency/new_semaphore.hpp"
+#include "containers/optional.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/shards.hpp"
+
+namespace ql {
+
+/* `parallel_terminal_t` evaluates the transforms and the terminal of an aggregation
+(`count`, `sum`, `avg`, `min`, `max` or `reduce`) over a range of a single shard on
+several threads at once.  The btree traversal itself stays on the store's thread,
+which hands contiguous runs of rows to helper threads.  Each helper keeps a partial
+accumulator of its own, and the partial results are combined with
+`accumulator_t::unshard()` once the traversal is done, just like the results of
+different shards are. */
+class parallel_terminal_t : public home_thread_mixin_debug_only_t {
+public:
+    // Returns true if the given aggregation is worth (and safe) evaluating in
+    // parallel.  `uses_val` is the `uses_val()` of the terminal's accumulator.
+    static bool can_parallelize(env_t *env,
+                                const std::vector<transform_variant_t> &transforms,
+                                const terminal_variant_t &terminal,
+                                bool uses_val);
+
+    parallel_terminal_t(env_t *env,
+                        const std::vector<transform_variant_t> &transforms,
+                        const terminal_variant_t &terminal);
+    ~parallel_terminal_t();
+
+    // Must be called in key order.  May block if the helper threads fall behind.
+    void add_row(datum_t &&row, size_t copies) THROWS_ONLY(interrupted_exc_t);
+
+    // Once one of the helpers has failed, the traversal should be aborted.
+    bool has_error() const { return error.has_value(); }
+
+    // Waits for the outstanding rows to be processed and combines the partial
+    // results into `accumulator`, which must not have seen any rows itself.  Throws
+    // `interrupted_exc_t` after the helpers are done if the query was interrupted.
+    void finish(accumulator_t *accumulator,
+                continue_bool_t last_cb,
+                result_t *out) THROWS_ONLY(interrupted_exc_t);
+
+private:
+    class worker_t {
+    public:
+        worker_t(threadnum_t _thread, signal_t *_interruptor);
+
+        const threadnum_t thread;
+        cross_thread_signal_t interruptor;
+
+        // Only one batch may be processed by a worker at a time.
+        new_mutex_t mutex;
+
+        // The number of batches handed to this worker that it hasn't finished yet.
+        // Only accessed on the home thread.
+        size_t pending_batches;
+
+        // These are created, used and destroyed on `thread`.
+        scoped_ptr_t<env_t> env;
+        std::vector<scoped_ptr_t<op_t> > transformers;
+        scoped_ptr_t<accumulator_t> accumulator;
+
+        // Whether any batch was handed to this worker, and its partial result.
+        bool has_run;
+        result_t result;
+    };
+
+    // Returns the worker with the fewest pending batches.
+    worker_t *choose_worker();
+    void dispatch_batch() THROWS_ONLY(interrupted_exc_t);
+    void process_batch(worker_t *worker,
+                       datums_t &batch,
+                       new_semaphore_in_line_t &in_flight_acq,
+                       auto_drainer_t::lock_t keepalive);
+    void run_on_worker_thread(worker_t *worker, datums_t *batch);
+    void finish_on_worker_thread(worker_t *worker);
+    void destroy_on_worker_thread(worker_t *worker);
+
+    env_t *const env;
+    const std::vector<transform_variant_t> transforms;
+    const terminal_variant_t terminal;
+
+    std::vector<scoped_ptr_t<worker_t> > workers;
+    size_t next_worker;
+
+    datums_t batch;
+    optional<exc_t> error;
+
+    // Bounds the number of batches that are queued up or being processed.
+    new_semaphore_t in_flight;
+
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(parallel_terminal_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_PARALLEL_TERMINAL_HPP_
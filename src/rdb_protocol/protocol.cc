@@ -599,16 +599,23 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
             rg_out->batchspec = rg_out->batchspec.scale_down(
                 rg.hints.has_value() ? rg.hints->size() : CPU_SHARDING_FACTOR);
             if (rg_out->primary_keys.has_value()) {
-                for (auto it = rg_out->primary_keys->begin();
-                     it != rg_out->primary_keys->end();) {
-                    auto cur_it = it++;
-                    if (!region_contains_key(rg_out->region, cur_it->first)) {
-                        rg_out->primary_keys->erase(cur_it);
+                // The keys are sorted, so we only have to check the hashes of the
+                // keys in the shard's key range.
+                const std::map<store_key_t, uint64_t> &all_keys = *rg.primary_keys;
+                const key_range_t &inner = rg_out->region.inner;
+                auto end = inner.right.unbounded
+                    ? all_keys.end()
+                    : all_keys.lower_bound(inner.right.key());
+                std::map<store_key_t, uint64_t> shard_keys;
+                for (auto it = all_keys.lower_bound(inner.left); it != end; ++it) {
+                    if (region_contains_key(rg_out->region, it->first)) {
+                        shard_keys.insert(shard_keys.end(), *it);
                     }
                 }
-                if (rg_out->primary_keys->empty()) {
+                if (shard_keys.empty()) {
                     return false;
                 }
+                rg_out->primary_keys.set(std::move(shard_keys));
             }
             if (rg_out->stamp.has_value()) {
                 rg_out->stamp->region = rg_out->region;
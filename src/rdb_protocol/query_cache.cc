@@ -2,12 +2,31 @@
 #include "rdb_protocol/query_cache.hpp"
 
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
 #include "rdb_protocol/pseudo_time.hpp"
 #include "rdb_protocol/response.hpp"
 #include "rdb_protocol/term_walker.hpp"
 
 namespace ql {
 
+// Runs `fn`, turning the errors it throws into `COMPILE_ERROR` responses.
+template <class callable_t>
+void convert_compile_errors(term_storage_t *term_storage, callable_t &&fn) {
+    try {
+        fn();
+    } catch (const exc_t &e) {
+        throw bt_exc_t(Response::COMPILE_ERROR,
+            e.get_error_type(),
+            e.what(),
+            term_storage->backtrace_registry().datum_backtrace(e));
+    } catch (const datum_exc_t &e) {
+        throw bt_exc_t(Response::COMPILE_ERROR,
+                       e.get_error_type(),
+                       e.what(),
+                       backtrace_registry_t::EMPTY_BACKTRACE);
+    }
+}
+
 query_cache_t::query_cache_t(
             rdb_context_t *_rdb_ctx,
             ip_and_port_t _client_addr_port,
@@ -17,6 +36,8 @@ query_cache_t::query_cache_t(
         client_addr_port(_client_addr_port),
         return_empty_normal_batches(_return_empty_normal_batches),
         user_context(std::move(_user_context)),
+        next_prepared_query_id(0),
+        prepared_queries(MAX_PREPARED_QUERIES),
         next_query_id(0),
         oldest_outstanding_query_id(0) {
     auto res = rdb_ctx->get_query_caches_for_this_thread()->insert(this);
@@ -49,28 +70,27 @@ scoped_ptr_t<query_cache_t::ref_t> query_cache_t::create(query_params_t *query_p
 
     global_optargs_t global_optargs;
     counted_t<const term_t> term_tree;
-    try {
-        query_params->term_storage->preprocess();
-        global_optargs = query_params->term_storage->global_optargs();
-
-        compile_env_t compile_env((var_visibility_t()));
-        term_tree = compile_term(&compile_env, query_params->term_storage->root_term());
-
-    } catch (const exc_t &e) {
-        throw bt_exc_t(Response::COMPILE_ERROR,
-            e.get_error_type(),
-            e.what(),
-            query_params->term_storage->backtrace_registry().datum_backtrace(e));
-    } catch (const datum_exc_t &e) {
-        throw bt_exc_t(Response::COMPILE_ERROR,
-                       e.get_error_type(),
-                       e.what(),
-                       backtrace_registry_t::EMPTY_BACKTRACE);
+    counted_t<const prepared_query_t> prepared_query;
+    std::vector<datum_t> prepared_args;
+    if (query_params->type == Query::EXECUTE) {
+        prepared_query =
+            get_prepared_query(query_params->term_storage->prepared_query_id());
+        term_tree = prepared_query->term_tree;
+        term_storage_t *term_storage = query_params->term_storage.get();
+        // Errors in the arguments are reported like errors in a `START` query.
+        convert_compile_errors(term_storage, [&]() {
+            global_optargs = term_storage->global_optargs();
+            prepared_args = term_storage->prepared_query_args();
+        });
+    } else {
+        term_tree = compile_query(query_params->term_storage.get(), &global_optargs);
     }
     scoped_ptr_t<entry_t> entry(new entry_t(query_params,
                                             std::move(global_optargs),
                                             std::move(deterministic_time),
-                                            std::move(term_tree)));
+                                            std::move(term_tree),
+                                            std::move(prepared_query),
+                                            std::move(prepared_args)));
 
     scoped_ptr_t<ref_t> ref(new ref_t(this,
                                       query_params->token,
@@ -101,6 +121,66 @@ scoped_ptr_t<query_cache_t::ref_t> query_cache_t::get(query_params_t *query_para
                                          interruptor));
 }
 
+int64_t query_cache_t::prepare(query_params_t *query_params) {
+    r_sanity_check(query_params->type == Query::PREPARE);
+    guarantee(this == query_params->query_cache);
+    assert_thread();
+    query_params->maybe_release_query_id();
+
+    std::string shape = query_params->term_storage->query_shape();
+    auto id_it = prepared_query_ids.find(shape);
+    if (id_it != prepared_query_ids.end()) {
+        // Mark the existing plan as recently used
+        counted_t<const prepared_query_t> *existing;
+        guarantee(prepared_queries.lookup(id_it->second, &existing));
+        return id_it->second;
+    }
+
+    // The global optargs come with each `EXECUTE` instead.
+    counted_t<const term_t> term_tree =
+        compile_query(query_params->term_storage.get(), nullptr);
+
+    int64_t id = next_prepared_query_id++;
+    prepared_query_ids.insert(std::make_pair(shape, id));
+    counted_t<const prepared_query_t> prepared_query(
+        new prepared_query_t(std::move(shape),
+                             std::move(query_params->term_storage),
+                             std::move(term_tree)));
+    guarantee(prepared_queries.insert(id, std::move(prepared_query),
+        [this](int64_t, counted_t<const prepared_query_t> &&evicted) {
+            // Running queries hold their own reference to the plan.
+            size_t erased = prepared_query_ids.erase(evicted->shape);
+            guarantee(erased == 1);
+        }));
+    return id;
+}
+
+counted_t<const term_t> query_cache_t::compile_query(
+        term_storage_t *term_storage,
+        global_optargs_t *global_optargs_out) {
+    counted_t<const term_t> term_tree;
+    convert_compile_errors(term_storage, [&]() {
+        term_storage->preprocess();
+        if (global_optargs_out != nullptr) {
+            *global_optargs_out = term_storage->global_optargs();
+        }
+        compile_env_t compile_env((var_visibility_t()));
+        term_tree = compile_term(&compile_env, term_storage->root_term());
+    });
+    return term_tree;
+}
+
+counted_t<const query_cache_t::prepared_query_t>
+query_cache_t::get_prepared_query(int64_t id) {
+    counted_t<const prepared_query_t> *res;
+    if (!prepared_queries.lookup(id, &res)) {
+        throw bt_exc_t(Response::CLIENT_ERROR, Response::QUERY_LOGIC,
+            strprintf("Prepared query %" PRIi64 " not in plan cache.", id),
+            backtrace_registry_t::EMPTY_BACKTRACE);
+    }
+    return *res;
+}
+
 void query_cache_t::noreply_wait(const query_params_t &query_params,
                                  signal_t *interruptor) {
     guarantee(this == query_params.query_cache);
@@ -252,13 +332,13 @@ void query_cache_t::ref_t::fill_response(response_t *res) {
         throw bt_exc_t(Response::RUNTIME_ERROR,
                        ex.get_error_type(),
                        ex.what(),
-                       entry->term_storage->backtrace_registry().datum_backtrace(ex));
+                       entry->backtrace_registry(ex.backtrace()).datum_backtrace(ex));
     } catch (const datum_exc_t &ex) {
         query_cache->terminate_internal(entry);
         throw bt_exc_t(Response::RUNTIME_ERROR,
                        ex.get_error_type(),
                        ex.what(),
-                       entry->term_storage->backtrace_registry().datum_backtrace(
+                       entry->backtrace_registry(backtrace_id_t::empty()).datum_backtrace(
                             backtrace_id_t::empty(), 0));
     } catch (const std::exception &ex) {
         query_cache->terminate_internal(entry);
@@ -273,6 +353,18 @@ void query_cache_t::ref_t::run(env_t *env, response_t *res) {
     scope_env_t scope_env(env, var_scope_t());
     scoped_ptr_t<val_t> val = entry->term_tree->eval(&scope_env);
 
+    if (entry->prepared_query.has()) {
+        // A prepared function is called with the arguments bound by `EXECUTE`.
+        if (val->get_type().is_convertible(val_t::type_t::FUNC)) {
+            val = val->as_func()->call(env, entry->prepared_args);
+        } else if (!entry->prepared_args.empty()) {
+            rfail_toplevel(base_exc_t::LOGIC,
+                           "Prepared query is not a function, "
+                           "but %zu arguments were given.",
+                           entry->prepared_args.size());
+        }
+    }
+
     if (val->get_type().is_convertible(val_t::type_t::DATUM)) {
         res->set_type(Response::SUCCESS_ATOM);
         res->set_data(val->as_datum());
@@ -359,7 +451,9 @@ void query_cache_t::ref_t::serve(env_t *env, response_t *res) {
 query_cache_t::entry_t::entry_t(query_params_t *query_params,
                                 global_optargs_t &&_global_optargs,
                                 ql::datum_t && _deterministic_time,
-                                counted_t<const term_t> &&_term_tree) :
+                                counted_t<const term_t> &&_term_tree,
+                                counted_t<const prepared_query_t> &&_prepared_query,
+                                std::vector<datum_t> &&_prepared_args) :
         state(state_t::START),
         interrupt_reason(interrupt_reason_t::UNKNOWN),
         job_id(generate_uuid()),
@@ -371,8 +465,33 @@ query_cache_t::entry_t::entry_t(query_params_t *query_params,
         deterministic_time(_deterministic_time),
         start_time(get_kiloticks()),
         term_tree(std::move(_term_tree)),
+        prepared_query(std::move(_prepared_query)),
+        prepared_args(std::move(_prepared_args)),
         has_sent_batch(false) { }
 
 query_cache_t::entry_t::~entry_t() { }
 
+const term_storage_t *query_cache_t::entry_t::query_term_storage() const {
+    return prepared_query.has()
+        ? prepared_query->term_storage.get()
+        : term_storage.get();
+}
+
+const backtrace_registry_t &query_cache_t::entry_t::backtrace_registry(
+        backtrace_id_t bt) const {
+    // The global optargs are preprocessed without registering any frames, so only
+    // frames of the prepared term tree come from the plan's registry.
+    return prepared_query.has() && bt.get() != backtrace_id_t::empty().get()
+        ? prepared_query->term_storage->backtrace_registry()
+        : term_storage->backtrace_registry();
+}
+
+query_cache_t::prepared_query_t::prepared_query_t(
+            std::string &&_shape,
+            scoped_ptr_t<term_storage_t> &&_term_storage,
+            counted_t<const term_t> &&_term_tree) :
+        shape(std::move(_shape)),
+        term_storage(std::move(_term_storage)),
+        term_tree(std::move(_term_tree)) { }
+
 } // namespace ql
@@ -19,6 +19,7 @@
 #include "containers/scoped.hpp"
 #include "containers/counted.hpp"
 #include "containers/intrusive_list.hpp"
+#include "containers/lru_cache.hpp"
 #include "containers/object_buffer.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/rdb_backtrace.hpp"
@@ -34,6 +35,7 @@ namespace ql {
 
 class query_cache_t : public home_thread_mixin_t {
     class entry_t;
+    class prepared_query_t;
 public:
     query_cache_t(rdb_context_t *_rdb_ctx,
                   ip_and_port_t _client_addr_port,
@@ -89,6 +91,11 @@ public:
     scoped_ptr_t<ref_t> get(query_params_t *query_params,
                             signal_t *interruptor);
 
+    // Compiles the term tree of a `PREPARE` query and keeps it in the plan cache,
+    // returning the id that `EXECUTE` queries use to run it.  Term trees with the
+    // same shape share a single plan.
+    int64_t prepare(query_params_t *query_params);
+
     void noreply_wait(const query_params_t &query_params,
                       signal_t *interruptor);
 
@@ -102,15 +109,45 @@ public:
 
     auth::user_context_t const &get_user_context() const;
 
+    // The maximum number of compiled plans kept per connection, beyond which the
+    // least recently used plan is evicted.
+    static const size_t MAX_PREPARED_QUERIES = 1024;
+
 private:
+    class prepared_query_t : public single_threaded_countable_t<prepared_query_t> {
+    public:
+        prepared_query_t(std::string &&_shape,
+                         scoped_ptr_t<term_storage_t> &&_term_storage,
+                         counted_t<const term_t> &&_term_tree);
+
+        const std::string shape;
+        // The order of these is important: `term_tree` points into `term_storage`.
+        const scoped_ptr_t<const term_storage_t> term_storage;
+        const counted_t<const term_t> term_tree;
+
+    private:
+        DISABLE_COPYING(prepared_query_t);
+    };
+
     class entry_t {
     public:
         entry_t(query_params_t *query_params,
                 global_optargs_t &&_global_optargs,
                 ql::datum_t &&_deterministic_time,
-                counted_t<const term_t> &&_term_tree);
+                counted_t<const term_t> &&_term_tree,
+                counted_t<const prepared_query_t> &&_prepared_query,
+                std::vector<datum_t> &&_prepared_args);
         ~entry_t();
 
+        // The term storage the query was compiled from - for `EXECUTE` queries this
+        // belongs to the prepared plan rather than to the query itself.
+        const term_storage_t *query_term_storage() const;
+
+        // The registry to resolve the backtrace `bt` of an error against.  For
+        // `EXECUTE` queries, errors in the prepared term tree are resolved against
+        // the plan's registry, and other errors against the query's own.
+        const backtrace_registry_t &backtrace_registry(backtrace_id_t bt) const;
+
         enum class state_t { START, STREAM, DONE, DELETING } state;
         interrupt_reason_t interrupt_reason;
 
@@ -130,6 +167,10 @@ private:
         // This will be empty if the root term has already been run
         counted_t<const term_t> term_tree;
 
+        // These are only set for `EXECUTE` queries
+        const counted_t<const prepared_query_t> prepared_query;
+        const std::vector<datum_t> prepared_args;
+
         // This will be empty until the root term has been evaluated
         // If this resulted in a stream, this will not be empty until the
         // stream is finished
@@ -146,12 +187,23 @@ private:
 
     static void async_destroy_entry(entry_t *entry);
 
+    // Preprocesses and compiles the query, and reads its global optargs into
+    // `global_optargs_out` unless it's null.  Throws `bt_exc_t`s.
+    static counted_t<const term_t> compile_query(term_storage_t *term_storage,
+                                                 global_optargs_t *global_optargs_out);
+    counted_t<const prepared_query_t> get_prepared_query(int64_t id);
+
     rdb_context_t *const rdb_ctx;
     ip_and_port_t client_addr_port;
     return_empty_normal_batches_t return_empty_normal_batches;
     auth::user_context_t user_context;
     std::map<int64_t, scoped_ptr_t<entry_t> > queries;
 
+    // Compiled plans of `PREPARE` queries, by id and by shape
+    int64_t next_prepared_query_id;
+    lru_cache_t<int64_t, counted_t<const prepared_query_t> > prepared_queries;
+    std::map<std::string, int64_t> prepared_query_ids;
+
     // Used for noreply waiting, this contains all allocated-but-incomplete query ids
     friend class query_params_t::query_id_t;
     uint64_t next_query_id;
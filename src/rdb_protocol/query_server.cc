@@ -40,7 +40,8 @@ void rdb_query_server_t::run_query(ql::query_params_t *query_params,
         scoped_perfmon_counter_t client_active(&rdb_ctx->stats.clients_active);
 
         switch (query_params->type) {
-        case Query::START: {
+        case Query::START:
+        case Query::EXECUTE: {
             scoped_ptr_t<ql::query_cache_t::ref_t> query_ref =
                 query_params->query_cache->create(query_params, ql::pseudo::time_now(),
                                                   interruptor);
@@ -59,6 +60,11 @@ void rdb_query_server_t::run_query(ql::query_params_t *query_params,
             query_params->query_cache->noreply_wait(*query_params, interruptor);
             response_out->set_type(Response::WAIT_COMPLETE);
         } break;
+        case Query::PREPARE: {
+            int64_t plan_id = query_params->query_cache->prepare(query_params);
+            response_out->set_type(Response::SUCCESS_ATOM);
+            response_out->set_data(ql::datum_t(static_cast<double>(plan_id)));
+        } break;
         case Query::SERVER_INFO: {
             fill_server_info(response_out);
             response_out->set_type(Response::SERVER_INFO);
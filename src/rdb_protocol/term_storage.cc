@@ -32,6 +32,8 @@ bool query_type_is_valid(Query::QueryType query_type) {
     case Query::STOP:
     case Query::NOREPLY_WAIT:
     case Query::SERVER_INFO:
+    case Query::PREPARE:
+    case Query::EXECUTE:
         return true;
     default:
         return false;
@@ -237,6 +239,24 @@ global_optargs_t term_storage_t::global_optargs() {
     unreachable();
 }
 
+std::string term_storage_t::query_shape() const {
+    r_sanity_check(false, "query_shape() is unimplemented "
+                   "for this term_storage_t type");
+    unreachable();
+}
+
+int64_t term_storage_t::prepared_query_id() const {
+    r_sanity_check(false, "prepared_query_id() is unimplemented "
+                   "for this term_storage_t type");
+    unreachable();
+}
+
+std::vector<datum_t> term_storage_t::prepared_query_args() const {
+    r_sanity_check(false, "prepared_query_args() is unimplemented "
+                   "for this term_storage_t type");
+    unreachable();
+}
+
 const backtrace_registry_t &term_storage_t::backtrace_registry() const {
     return bt_reg;
 }
@@ -272,6 +292,18 @@ json_term_storage_t::json_term_storage_t(scoped_array_t<char> &&_original_data,
                        backtrace_registry_t::EMPTY_BACKTRACE);
     }
 
+    if (static_cast<Query::QueryType>(query_json[0].GetInt()) == Query::EXECUTE) {
+        if (query_json.Size() < 2 ||
+            !query_json[1].IsArray() ||
+            query_json[1].Size() == 0 ||
+            !query_json[1][0].IsInt64()) {
+            throw bt_exc_t(Response::CLIENT_ERROR, Response::QUERY_LOGIC,
+                           "Expected an EXECUTE query to start with an array "
+                           "holding a prepared query id and its arguments.",
+                           backtrace_registry_t::EMPTY_BACKTRACE);
+        }
+    }
+
     if (query_json.Size() >= 3) {
         if (!query_json[2].IsObject()) {
             throw bt_exc_t(Response::CLIENT_ERROR, Response::QUERY_LOGIC,
@@ -363,6 +395,33 @@ global_optargs_t json_term_storage_t::global_optargs() {
     return res;
 }
 
+std::string json_term_storage_t::query_shape() const {
+    r_sanity_check(query_json.Size() >= 2);
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    query_json[1].Accept(writer);
+    return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+int64_t json_term_storage_t::prepared_query_id() const {
+    r_sanity_check(query_type() == Query::EXECUTE);
+    return query_json[1][0].GetInt64();
+}
+
+std::vector<datum_t> json_term_storage_t::prepared_query_args() const {
+    r_sanity_check(query_type() == Query::EXECUTE);
+    const rapidjson::Value &body = query_json[1];
+    std::vector<datum_t> res;
+    res.reserve(body.Size() - 1);
+    for (size_t i = 1; i < body.Size(); ++i) {
+        // Arguments are parsed the same way as the datums of a `DATUM` term.
+        res.push_back(to_datum(body[i],
+                               configured_limits_t::unlimited,
+                               reql_version_t::LATEST));
+    }
+    return res;
+}
+
 wire_term_storage_t::wire_term_storage_t(scoped_array_t<char> &&_original_data,
                                          rapidjson::Document &&_func_json) :
         original_data(std::move(_original_data)),
@@ -135,6 +135,15 @@ public:
     virtual void preprocess();
     virtual global_optargs_t global_optargs();
 
+    // Used by `PREPARE` queries to find an already-compiled plan for the same term
+    // tree.  This must be called before `preprocess()`.
+    virtual std::string query_shape() const;
+
+    // Only valid for `EXECUTE` queries, which carry a plan id and its arguments
+    // instead of a term tree.
+    virtual int64_t prepared_query_id() const;
+    virtual std::vector<datum_t> prepared_query_args() const;
+
 protected:
     backtrace_registry_t bt_reg;
 };
@@ -149,6 +158,9 @@ public:
     void preprocess();
     raw_term_t root_term() const;
     global_optargs_t global_optargs();
+    std::string query_shape() const;
+    int64_t prepared_query_id() const;
+    std::vector<datum_t> prepared_query_args() const;
 private:
     scoped_array_t<char> original_data;
     rapidjson::Document query_json;
@@ -236,6 +236,10 @@ counted_t<term_t> make_skip_term(
 }
 counted_t<term_t> make_inner_join_term(
         compile_env_t *env, const raw_term_t &term) {
+    counted_t<term_t> hash_join = make_inner_hash_join_term(env, term);
+    if (hash_join.has()) {
+        return hash_join;
+    }
     return make_counted<inner_join_term_t>(env, term);
 }
 counted_t<term_t> make_outer_join_term(
@@ -8,6 +8,7 @@
 #include "parsing/utf8.hpp"
 #include "rdb_protocol/datum_stream/eq_join.hpp"
 #include "rdb_protocol/datum_stream/fold.hpp"
+#include "rdb_protocol/datum_stream/hash_join.hpp"
 #include "rdb_protocol/datum_stream/map.hpp"
 #include "rdb_protocol/datum_stream/ordered_union.hpp"
 #include "rdb_protocol/datum_stream/range.hpp"
@@ -16,6 +17,7 @@
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/math_utils.hpp"
+#include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/order_util.hpp"
 
@@ -262,6 +264,160 @@ private:
     }
 };
 
+// Matches `var(field)` or `var.bracket(field)` for a literal string `field`.
+bool match_var_field(const raw_term_t &term, double *var_out) {
+    if ((term.type() != Term::GET_FIELD && term.type() != Term::BRACKET)
+        || term.num_args() != 2 || term.num_optargs() != 0) {
+        return false;
+    }
+    raw_term_t var = term.arg(0);
+    raw_term_t field = term.arg(1);
+    if (var.type() != Term::VAR || var.num_args() != 1
+        || var.arg(0).type() != Term::DATUM || field.type() != Term::DATUM) {
+        return false;
+    }
+    datum_t var_name = var.arg(0).datum();
+    if (var_name.get_type() != datum_t::R_NUM
+        || field.datum().get_type() != datum_t::R_STR) {
+        return false;
+    }
+    *var_out = var_name.as_num();
+    return true;
+}
+
+// Matches the argument list of a two-argument `FUNC` term.
+bool match_func_vars(const raw_term_t &vars, double *a_out, double *b_out) {
+    std::vector<datum_t> names;
+    if (vars.type() == Term::DATUM) {
+        datum_t d = vars.datum();
+        if (d.get_type() != datum_t::R_ARRAY) {
+            return false;
+        }
+        for (size_t i = 0; i < d.arr_size(); ++i) {
+            names.push_back(d.get(i));
+        }
+    } else if (vars.type() == Term::MAKE_ARRAY) {
+        for (size_t i = 0; i < vars.num_args(); ++i) {
+            if (vars.arg(i).type() != Term::DATUM) {
+                return false;
+            }
+            names.push_back(vars.arg(i).datum());
+        }
+    } else {
+        return false;
+    }
+    if (names.size() != 2
+        || names[0].get_type() != datum_t::R_NUM
+        || names[1].get_type() != datum_t::R_NUM) {
+        return false;
+    }
+    *a_out = names[0].as_num();
+    *b_out = names[1].as_num();
+    return *a_out != *b_out;
+}
+
+/* `inner_join` is rewritten into a nested `concat_map` that evaluates the right-hand
+sequence once per left-hand row.  If the predicate is a literal function of the form
+`function(l, r) { return l(a).eq(r(b)); }`, we use a hash join instead, which reads
+the right-hand side just once if the left-hand side is finite. */
+class inner_hash_join_term_t : public grouped_seq_op_term_t {
+public:
+    inner_hash_join_term_t(compile_env_t *env,
+                           const raw_term_t &term,
+                           const raw_term_t &left_field,
+                           const raw_term_t &right_field)
+        : grouped_seq_op_term_t(env, term, argspec_t(3)) {
+        minidriver_t r(term.bt());
+        left_key = make_counted<func_term_t>(
+            env, key_func(&r, minidriver_t::dummy_var_t::INNERJOIN_N, left_field));
+        right_key = make_counted<func_term_t>(
+            env, key_func(&r, minidriver_t::dummy_var_t::INNERJOIN_M, right_field));
+        left_reader = make_counted<func_term_t>(
+            env, r.fun(r.expr(term.arg(0))).root_term());
+        right_reader = make_counted<func_term_t>(
+            env, r.fun(r.expr(term.arg(1))).root_term());
+    }
+
+    // Returns the fields the predicate of `term` compares, if it's an equi-join.
+    static bool match(const raw_term_t &term,
+                      optional<raw_term_t> *left_field_out,
+                      optional<raw_term_t> *right_field_out) {
+        if (term.num_args() != 3 || term.num_optargs() != 0) {
+            return false;
+        }
+        raw_term_t func = term.arg(2);
+        if (func.type() != Term::FUNC || func.num_args() != 2
+            || func.num_optargs() != 0) {
+            return false;
+        }
+        double left_var, right_var;
+        if (!match_func_vars(func.arg(0), &left_var, &right_var)) {
+            return false;
+        }
+        raw_term_t body = func.arg(1);
+        if (body.type() != Term::EQ || body.num_args() != 2
+            || body.num_optargs() != 0) {
+            return false;
+        }
+        double var0, var1;
+        if (!match_var_field(body.arg(0), &var0)
+            || !match_var_field(body.arg(1), &var1)) {
+            return false;
+        }
+        if (var0 == left_var && var1 == right_var) {
+            left_field_out->set(body.arg(0));
+            right_field_out->set(body.arg(1));
+        } else if (var0 == right_var && var1 == left_var) {
+            left_field_out->set(body.arg(1));
+            right_field_out->set(body.arg(0));
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    virtual const char *name() const { return "inner_join"; }
+private:
+    // Builds `function(row) { return row(field); }`, using the same term type for
+    // the field access as the original predicate.
+    static raw_term_t key_func(minidriver_t *r,
+                               minidriver_t::dummy_var_t var,
+                               const raw_term_t &field_access) {
+        return r->fun(var, r->var(var).call(field_access.type(),
+                                            field_access.arg(1))).root_term();
+    }
+
+    virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env,
+                                          args_t *args,
+                                          eval_flags_t) const {
+        counted_t<const func_t> left_func = left_reader->eval_to_func(env->scope);
+        // Within a query, `r.now()` is constant.
+        const bool left_is_deterministic = left_func->is_deterministic().test(
+            single_server_t::yes, constant_now_t::yes);
+        counted_t<datum_stream_t> left = args->arg(env, 0)->as_seq(env->env);
+        counted_t<datum_stream_t> right = args->arg(env, 1)->as_seq(env->env);
+        rcheck(!right->is_infinite(),
+               base_exc_t::LOGIC,
+               "Cannot use an infinite stream as the right-hand side of `inner_join`.");
+        counted_t<datum_stream_t> join_stream =
+            make_counted<hash_join_datum_stream_t>(
+                std::move(left),
+                std::move(left_func),
+                left_is_deterministic,
+                std::move(right),
+                right_reader->eval_to_func(env->scope),
+                left_key->eval_to_func(env->scope),
+                right_key->eval_to_func(env->scope),
+                backtrace());
+        return new_val(env->env, join_stream);
+    }
+
+    counted_t<const func_term_t> left_key;
+    counted_t<const func_term_t> right_key;
+    counted_t<const func_term_t> left_reader;
+    counted_t<const func_term_t> right_reader;
+};
+
 class fold_term_t : public grouped_seq_op_term_t {
 public:
     fold_term_t(compile_env_t *env, const raw_term_t &term)
@@ -544,6 +700,9 @@ private:
     virtual scoped_ptr_t<val_t> eval_impl(
         scope_env_t *env, args_t *args, eval_flags_t) const {
 
+        // Even with `squash: false`, changes to the same document get squashed if
+        // the server runs low on memory for queued changes.  The feed then sends
+        // an error object saying so (see `subscription_t::get_els`).
         scoped_ptr_t<val_t> sval = args->optarg(env, "squash");
         datum_t squash = sval.has() ? sval->as_datum() : datum_t::boolean(false);
         if (squash.get_type() == datum_t::type_t::R_NUM) {
@@ -901,6 +1060,15 @@ counted_t<term_t> make_eq_join_term(
     return make_counted<eq_join_term_t>(env, term);
 }
 
+counted_t<term_t> make_inner_hash_join_term(
+        compile_env_t *env, const raw_term_t &term) {
+    optional<raw_term_t> left_field, right_field;
+    if (!inner_hash_join_term_t::match(term, &left_field, &right_field)) {
+        return counted_t<term_t>();
+    }
+    return make_counted<inner_hash_join_term_t>(env, term, *left_field, *right_field);
+}
+
 counted_t<term_t> make_fold_term(
         compile_env_t *env, const raw_term_t &term) {
     return make_counted<fold_term_t>(env, term);
@@ -259,6 +259,9 @@ counted_t<term_t> make_map_term(
     compile_env_t *env, const raw_term_t &term);
 counted_t<term_t> make_fold_term(
     compile_env_t *env, const raw_term_t &term);
+// Returns an empty pointer if the predicate isn't a simple field equality.
+counted_t<term_t> make_inner_hash_join_term(
+    compile_env_t *env, const raw_term_t &term);
 counted_t<term_t> make_filter_term(
     compile_env_t *env, const raw_term_t &term);
 counted_t<term_t> make_concatmap_term(
@@ -4,6 +4,7 @@
 #ifndef _WIN32
 #include <netinet/in.h>
 #endif
+#include <zlib.h>
 
 #include <algorithm>
 #include <functional>
@@ -128,30 +129,68 @@ void connectivity_cluster_t::connection_t::kill_connection() {
     }
 }
 
+ql::datum_t connectivity_cluster_t::connection_t::get_stats() {
+    void *data = pm_collection.begin_stats();
+    pmap(get_num_threads(), [&](int thread_id) {
+        on_thread_t thread_switcher((threadnum_t(thread_id)));
+        pm_collection.visit_stats(data);
+    });
+    return pm_collection.end_stats(data);
+}
+
 connectivity_cluster_t::connection_t::connection_t(
         run_t *_parent,
         const peer_id_t &_peer_id,
         const server_id_t &_server_id,
         keepalive_tcp_conn_stream_t *_conn,
-        const peer_address_t &_peer_address) THROWS_NOTHING :
+        const peer_address_t &_peer_address,
+        bool _compress_messages) THROWS_NOTHING :
     conn(_conn),
     peer_address(_peer_address),
-    flusher([&](signal_t *) {
+    compress_messages(_compress_messages),
+    flusher([&](signal_t *interruptor) {
         guarantee(this->conn != nullptr);
+        // Messages that are sent at about the same time should share a flush.
+        if (CLUSTER_FLUSH_DELAY_MS > 0) {
+            nap(CLUSTER_FLUSH_DELAY_MS, interruptor);
+        } else {
+            coro_t::yield();
+        }
         // We need to acquire the send_mutex because flushing the buffer
         // must not interleave with other writes (restriction of linux_tcp_conn_t).
         mutex_t::acq_t acq(&this->send_mutex);
+        // Everything that was written before anyone notified us is in the buffer
+        // now, so there's no need to run again for those notifications.
+        this->flusher.include_latest_notifications();
+        int64_t messages = this->unflushed_messages;
+        ticks_t first_ticks = this->first_unflushed_ticks;
+        this->unflushed_messages = 0;
         // We ignore the return value of flush_buffer(). Closed connections
         // must be handled elsewhere.
         this->conn->flush_buffer();
+        if (messages > 0) {
+            this->pm_messages_per_flush.record(messages);
+            this->pm_flush_latency.record(
+                ticks_to_secs(ticks_t{get_ticks().nanos - first_ticks.nanos}));
+        }
     }, 1),
+    unflushed_messages(0),
+    first_unflushed_ticks(ticks_t{0}),
     pm_collection(),
     pm_bytes_sent(secs_to_ticks(1), true),
+    pm_messages_per_flush(secs_to_ticks(1), false),
+    pm_flush_latency(secs_to_ticks(1), false),
     pm_collection_membership(
         &_parent->parent->connectivity_collection,
         &pm_collection,
         uuid_to_str(_peer_id.get_uuid())),
     pm_bytes_sent_membership(&pm_collection, &pm_bytes_sent, "bytes_sent"),
+    pm_compression_membership(&pm_collection,
+        &pm_compression_bytes_in, "compression_bytes_in",
+        &pm_compression_bytes_out, "compression_bytes_out"),
+    pm_flush_membership(&pm_collection,
+        &pm_messages_per_flush, "messages_per_flush",
+        &pm_flush_latency, "flush_latency"),
     parent(_parent),
     peer_id(_peer_id),
     server_id(_server_id),
@@ -221,11 +260,13 @@ connectivity_cluster_t::run_t::run_t(
             _heartbeat_sl_view,
         std::shared_ptr<semilattice_read_view_t<auth_semilattice_metadata_t> >
             _auth_sl_view,
-        tls_ctx_t *_tls_ctx)
+        tls_ctx_t *_tls_ctx,
+        bool _compress_messages)
         THROWS_ONLY(address_in_use_exc_t, tcp_socket_exc_t) :
     parent(_parent),
     server_id(_server_id),
     tls_ctx(_tls_ctx),
+    compress_messages(_compress_messages),
 
     /* Create the socket to use when listening for connections from peers */
     cluster_listener_socket(new tcp_bound_socket_t(local_addresses, port)),
@@ -257,7 +298,8 @@ connectivity_cluster_t::run_t::run_t(
     `connection_map` on each thread and notifying any listeners that we're now
     connected to ourself. The destructor will remove us from the
     `connection_map` and again notify any listeners. */
-    connection_to_ourself(this, parent->me, _server_id, nullptr, routing_table[parent->me]),
+    connection_to_ourself(
+        this, parent->me, _server_id, nullptr, routing_table[parent->me], false),
 
     heartbeat_sl_view(_heartbeat_sl_view),
     auth_sl_view(_auth_sl_view),
@@ -736,8 +778,8 @@ enum class handshake_result_code_t {
 class handshake_result_t {
 public:
     handshake_result_t() { }
-    static handshake_result_t success() {
-        return handshake_result_t(handshake_result_code_t::SUCCESS);
+    static handshake_result_t success(const std::set<std::string> &features) {
+        return handshake_result_t(handshake_result_code_t::SUCCESS, features);
     }
     static handshake_result_t error(handshake_result_code_t error_code,
                                     const std::string &additional_info) {
@@ -748,6 +790,15 @@ public:
         return code;
     }
 
+    /* On success, `additional_info` holds the optional protocol features that the
+    sender supports, separated by spaces. Older servers leave it empty and ignore it
+    when they receive it. */
+    bool has_feature(const std::string &feature) const {
+        guarantee(code == handshake_result_code_t::SUCCESS);
+        std::string padded = " " + additional_info + " ";
+        return padded.find(" " + feature + " ") != std::string::npos;
+    }
+
     std::string get_error_reason() const {
         if (code == handshake_result_code_t::UNKNOWN_ERROR) {
             return error_code_string + " (" + additional_info + ")";
@@ -785,9 +836,16 @@ private:
         guarantee(code != handshake_result_code_t::SUCCESS);
         error_code_string = get_code_as_string();
     }
-    explicit handshake_result_t(handshake_result_code_t _success)
+    handshake_result_t(handshake_result_code_t _success,
+                       const std::set<std::string> &features)
         : code(_success) {
         guarantee(code == handshake_result_code_t::SUCCESS);
+        for (const std::string &feature : features) {
+            if (!additional_info.empty()) {
+                additional_info += " ";
+            }
+            additional_info += feature;
+        }
     }
 
     friend void serialize_universal(write_message_t *, const handshake_result_t &);
@@ -834,6 +892,89 @@ archive_result_t deserialize_universal(read_stream_t *s, handshake_result_t *out
     return res;
 }
 
+// The feature that `handshake_result_t::success()` lists if we can receive messages
+// with the `compressed_tag`.
+static const char *const compressed_messages_feature = "zlib-messages";
+
+/* A compressed message consists of the `compressed_tag`, the tag of the original
+message, the sizes of the original and the compressed message as `uint64_t`s and
+the message itself compressed with zlib. */
+void read_compressed_message(read_stream_t *stream,
+                             connectivity_cluster_t::message_tag_t *tag_out,
+                             std::vector<char> *data_out) {
+    uint64_t size, compressed_size;
+    if (bad(deserialize_universal(stream, tag_out))
+        || bad(deserialize_universal(stream, &size))
+        || bad(deserialize_universal(stream, &compressed_size))) {
+        throw fake_archive_exc_t();
+    }
+    // zlib can't compress by more than a factor of about 1000, so anything beyond
+    // that is garbage and we don't want to allocate memory for it.
+    if (*tag_out == connectivity_cluster_t::compressed_tag
+        || *tag_out == connectivity_cluster_t::heartbeat_tag
+        || compressed_size > CLUSTER_COMPRESSED_MESSAGE_MAX_SIZE
+        || size > compressed_size * 1032 + 64) {
+        throw fake_archive_exc_t();
+    }
+    std::vector<char> compressed(compressed_size);
+    if (force_read(stream, compressed.data(), compressed_size)
+        != static_cast<int64_t>(compressed_size)) {
+        throw fake_archive_exc_t();
+    }
+    data_out->resize(size);
+    uLongf actual_size = size;
+    int res = uncompress(reinterpret_cast<Bytef *>(data_out->data()),
+                         &actual_size,
+                         reinterpret_cast<const Bytef *>(compressed.data()),
+                         compressed_size);
+    if (res != Z_OK || actual_size != size) {
+        throw fake_archive_exc_t();
+    }
+}
+
+/* Replaces the message in `buffer`, which starts after `header_size` bytes of
+framing, with its compressed version if that's worth it. */
+void maybe_compress_message(connectivity_cluster_t::message_tag_t tag,
+                            size_t header_size,
+                            perfmon_counter_t *bytes_in,
+                            perfmon_counter_t *bytes_out,
+                            vector_stream_t *buffer) {
+    size_t size = buffer->vector().size() - header_size;
+    if (size < CLUSTER_COMPRESSION_MIN_MESSAGE_SIZE) {
+        return;
+    }
+    std::vector<char> message;
+    buffer->swap(&message);
+
+    uLongf compressed_size = compressBound(size);
+    std::vector<char> compressed(compressed_size);
+    int res = compress2(reinterpret_cast<Bytef *>(compressed.data()),
+                        &compressed_size,
+                        reinterpret_cast<const Bytef *>(message.data() + header_size),
+                        size,
+                        Z_BEST_SPEED);
+    // Uncompressible data isn't worth the receiver's time.
+    if (res != Z_OK || compressed_size > size - size / 8) {
+        buffer->swap(&message);
+        return;
+    }
+
+    message.clear();
+    buffer->swap(&message);
+    write_message_t wm;
+    serialize_universal(&wm, connectivity_cluster_t::compressed_tag);
+    serialize_universal(&wm, tag);
+    serialize_universal(&wm, static_cast<uint64_t>(size));
+    serialize_universal(&wm, static_cast<uint64_t>(compressed_size));
+    int write_res = send_write_message(buffer, &wm);
+    guarantee(write_res == 0);
+    write_res = buffer->write(compressed.data(), compressed_size);
+    guarantee(write_res == static_cast<int64_t>(compressed_size));
+
+    (*bytes_in) += size;
+    (*bytes_out) += compressed_size;
+}
+
 void fail_handshake(keepalive_tcp_conn_stream_t *conn,
                     const char *peername,
                     const handshake_result_t &reason,
@@ -1065,6 +1206,7 @@ join_result_t connectivity_cluster_t::run_t::handle(
     }
 
     // Receive id, host/ports.
+    bool peer_accepts_compressed_messages = false;
     peer_id_t other_id;
     std::set<host_and_port_t> other_peer_addr_hosts;
     if (deserialize_universal_and_check(conn, &other_id, peername) ||
@@ -1073,9 +1215,11 @@ join_result_t connectivity_cluster_t::run_t::handle(
     }
 
     {
-        // Tell the other node that we are happy to connect with it
+        // Tell the other node that we are happy to connect with it, and which
+        // optional features we support.
         write_message_t wm;
-        serialize_universal(&wm, handshake_result_t::success());
+        serialize_universal(&wm, handshake_result_t::success(
+            std::set<std::string>{compressed_messages_feature}));
         if (send_write_message(conn, &wm)) {
             return join_result_t::TEMPORARY_ERROR; // network error.
         }
@@ -1094,6 +1238,8 @@ join_result_t connectivity_cluster_t::run_t::handle(
                 return join_result_t::TEMPORARY_ERROR;
             return join_result_t::PERMANENT_ERROR;
         }
+        peer_accepts_compressed_messages =
+            handshake_result.has_feature(compressed_messages_feature);
     }
 
     // Look up the ip addresses for the other host
@@ -1317,7 +1463,8 @@ join_result_t connectivity_cluster_t::run_t::handle(
         constructor registers it in the `connectivity_cluster_t`'s connection
         map. */
         connection_t conn_structure(
-            this, other_id, remote_server_id, conn, *other_peer_addr.get());
+            this, other_id, remote_server_id, conn, *other_peer_addr.get(),
+            compress_messages && peer_accepts_compressed_messages);
 
         /* `heartbeat_manager` will periodically send a heartbeat message to
         other servers, and it will also close the connection if we don't
@@ -1341,7 +1488,19 @@ join_result_t connectivity_cluster_t::run_t::handle(
                 /* Ignore messages tagged with the heartbeat tag. The
                 `keepalive_tcp_conn_stream_t` will have already notified the
                 `heartbeat_manager_t` as soon as the heartbeat arrived. */
-                if (tag != heartbeat_tag) {
+                if (tag == compressed_tag) {
+                    std::vector<char> data;
+                    read_compressed_message(conn, &tag, &data);
+                    cluster_message_handler_t *handler = parent->message_handlers[tag];
+                    guarantee(handler != nullptr, "Got a message for an unfamiliar tag. "
+                        "Apparently we aren't compatible with the cluster on the other "
+                        "end.");
+                    guarantee(resolved_version == cluster_version_t::CLUSTER);
+                    handler->on_local_message(
+                        &conn_structure,
+                        auto_drainer_t::lock_t(conn_structure.drainers.get()),
+                        std::move(data)); // might raise fake_archive_exc_t
+                } else if (tag != heartbeat_tag) {
                     cluster_message_handler_t *handler = parent->message_handlers[tag];
                     guarantee(handler != nullptr, "Got a message for an unfamiliar tag. "
                         "Apparently we aren't compatible with the cluster on the other "
@@ -1463,6 +1622,38 @@ connectivity_cluster_t::connection_t *connectivity_cluster_t::get_connection(
     return conn;
 }
 
+/* Takes a buffer from the current thread's `send_buffers` (or makes a new one) and
+puts it back once the message has been sent. Must be destroyed on the thread it was
+created on. */
+class send_buffer_t {
+public:
+    explicit send_buffer_t(std::vector<std::vector<char> > *_free_buffers)
+        : free_buffers(_free_buffers) {
+        if (!free_buffers->empty()) {
+            stream.swap(&free_buffers->back());
+            free_buffers->pop_back();
+        } else {
+            // Reserve some space to reduce overhead (especially for small messages)
+            stream.reserve(1024);
+        }
+    }
+    ~send_buffer_t() {
+        std::vector<char> data;
+        stream.swap(&data);
+        if (data.capacity() != 0
+            && data.capacity() <= CLUSTER_SEND_BUFFER_MAX_REUSED_SIZE
+            && free_buffers->size() < CLUSTER_SEND_BUFFER_MAX_REUSED_COUNT) {
+            data.clear();
+            free_buffers->push_back(std::move(data));
+        }
+    }
+    vector_stream_t stream;
+private:
+    std::vector<std::vector<char> > *free_buffers;
+
+    DISABLE_COPYING(send_buffer_t);
+};
+
 void connectivity_cluster_t::send_message(connection_t *connection,
                                      auto_drainer_t::lock_t connection_keepalive,
                                      message_tag_t tag,
@@ -1475,17 +1666,36 @@ void connectivity_cluster_t::send_message(connection_t *connection,
         return;
     }
 
-    /* We currently write the message to a vector_stream_t, then
-       serialize that as a string. It's horribly inefficient, of course. */
-    // TODO: If we don't do it this way, we (or the caller) will need
-    // to worry about having the writer run on the connection thread.
-    vector_stream_t buffer;
-    // Reserve some space to reduce overhead (especially for small messages)
-    buffer.reserve(1024);
+    /* We serialize the message on the calling thread, into a buffer that's reused
+    by later messages from this thread. For the network, the tag goes in front of
+    the message in the same buffer, so that it can be written in one go. */
+    send_buffer_t send_buffer(send_buffers.get());
+    vector_stream_t &buffer = send_buffer.stream;
+    size_t header_size = 0;
+    if (!connection->is_loopback()) {
+        // All cluster versions use a uint8_t tag here.
+        write_message_t wm;
+        static_assert(std::is_same<message_tag_t, uint8_t>::value,
+                      "We expect to be serializing a uint8_t -- if this has "
+                      "changed, the cluster communication format has changed and "
+                      "you need to ask yourself whether live cluster upgrades work."
+                      );
+        serialize_universal(&wm, tag);
+        int res = send_write_message(&buffer, &wm);
+        guarantee(res == 0);
+        header_size = buffer.vector().size();
+    }
     {
         ASSERT_FINITE_CORO_WAITING;
         callback->write(&buffer);
     }
+    size_t bytes_sent = buffer.vector().size() - header_size;
+    if (connection->compress_messages) {
+        maybe_compress_message(tag, header_size,
+                               &connection->pm_compression_bytes_in,
+                               &connection->pm_compression_bytes_out,
+                               &buffer);
+    }
 
 #ifdef CLUSTER_MESSAGE_DEBUGGING
     {
@@ -1509,8 +1719,6 @@ void connectivity_cluster_t::send_message(connection_t *connection,
     }
 #endif
 
-    size_t bytes_sent = buffer.vector().size();
-
 #ifdef ENABLE_MESSAGE_PROFILER
     std::pair<uint64_t, uint64_t> *stats =
         &(*message_profiler_counts.get())[callback->message_profiler_tag()];
@@ -1526,27 +1734,28 @@ void connectivity_cluster_t::send_message(connection_t *connection,
         message_handlers[tag]->on_local_message(connection, connection_keepalive,
             std::move(buffer_data));
     } else {
+        bool is_bulk = bytes_sent >= CLUSTER_BULK_MESSAGE_MIN_SIZE
+            && message_handlers[tag] != nullptr
+            && message_handlers[tag]->messages_may_be_reordered();
+
         on_thread_t threader(connection->conn->home_thread());
 
         /* Acquire the send-mutex so we don't collide with other things trying
         to send on the same connection. */
         {
+            object_buffer_t<mutex_t::acq_t> bulk_acq;
+            if (is_bulk) {
+                bulk_acq.create(&connection->bulk_send_mutex, true);
+            }
+
             /* The `true` is for eager waiting, which is a significant performance
             optimization in this case. */
             mutex_t::acq_t acq(&connection->send_mutex, true);
 
-            /* Write the tag to the network */
+            /* Write the tag and the message to the network */
             {
-                // All cluster versions use a uint8_t tag here.
-                write_message_t wm;
-                static_assert(std::is_same<message_tag_t, uint8_t>::value,
-                              "We expect to be serializing a uint8_t -- if this has "
-                              "changed, the cluster communication format has changed and "
-                              "you need to ask yourself whether live cluster upgrades work."
-                              );
-                serialize_universal(&wm, tag);
-                make_buffered_tcp_conn_stream_wrapper_t buffered_conn(connection->conn);
-                int res = send_write_message(&buffered_conn, &wm);
+                int64_t res = connection->conn->write_buffered(buffer.vector().data(),
+                                                               buffer.vector().size());
                 if (res == -1) {
                     /* Close the other half of the connection to make sure that
                        `connectivity_cluster_t::run_t::handle()` notices that something is
@@ -1555,22 +1764,13 @@ void connectivity_cluster_t::send_message(connection_t *connection,
                         connection->conn->shutdown_read();
                     }
                     return;
-                }
-            }
-
-            /* Write the message itself to the network */
-            {
-                int64_t res = connection->conn->write_buffered(buffer.vector().data(),
-                                                               buffer.vector().size());
-                if (res == -1) {
-                    if (connection->conn->is_read_open()) {
-                        connection->conn->shutdown_read();
-                    }
-                    return;
                 } else {
                     guarantee(res == static_cast<int64_t>(buffer.vector().size()));
                 }
             }
+            if (connection->unflushed_messages++ == 0) {
+                connection->first_unflushed_ticks = get_ticks();
+            }
         } /* Releases the send_mutex */
 
         connection->flusher.notify();
@@ -1596,6 +1796,9 @@ cluster_message_handler_t::cluster_message_handler_t(
     rassert(tag != connectivity_cluster_t::heartbeat_tag,
         "Tag %" PRIu8 " is reserved for heartbeat messages.",
         connectivity_cluster_t::heartbeat_tag);
+    rassert(tag != connectivity_cluster_t::compressed_tag,
+        "Tag %" PRIu8 " is reserved for compressed messages.",
+        connectivity_cluster_t::compressed_tag);
     rassert(connectivity_cluster->message_handlers[tag] == nullptr);
     connectivity_cluster->message_handlers[tag] = this;
 }
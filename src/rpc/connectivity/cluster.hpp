@@ -105,6 +105,11 @@ public:
     /* This tag is reserved exclusively for heartbeat messages. */
     static const message_tag_t heartbeat_tag = 'H';
 
+    /* This tag is reserved for compressed messages, which carry the tag of the
+    original message. We only send them to peers that said during the handshake that
+    they understand them. */
+    static const message_tag_t compressed_tag = 'Z';
+
     class run_t;
 
     /* `connection_t` represents an open connection to another server. If we lose
@@ -141,6 +146,15 @@ public:
             return conn == nullptr;
         }
 
+        /* Returns `true` if large messages to this peer are compressed. */
+        bool compresses_messages() const {
+            return compress_messages;
+        }
+
+        /* Collects the stats of this connection, such as `compression_bytes_in` and
+        `compression_bytes_out`. Must be called in a coroutine, and blocks. */
+        ql::datum_t get_stats();
+
         /* Drops the connection. */
         void kill_connection();
 
@@ -154,7 +168,8 @@ public:
             const peer_id_t &peer_id,
             const server_id_t &server_id,
             keepalive_tcp_conn_stream_t *,
-            const peer_address_t &peer_address) THROWS_NOTHING;
+            const peer_address_t &peer_address,
+            bool compress_messages) THROWS_NOTHING;
         ~connection_t() THROWS_NOTHING;
 
         /* NULL for the loopback connection (i.e. our "connection" to ourself) */
@@ -168,13 +183,33 @@ public:
         /* Unused for our connection to ourself */
         mutex_t send_mutex;
 
+        /* Large messages that may be reordered take this before `send_mutex`. That
+        way at most one of them is waiting for `send_mutex` at any time, and smaller
+        messages don't queue up behind a whole series of them. */
+        mutex_t bulk_send_mutex;
+
+        /* Whether large messages are compressed before they are sent. */
+        const bool compress_messages;
+
         /* Calls `conn->flush_buffer()`. Can be used for making sure that a
-        buffered write makes it to the TCP stack. */
+        buffered write makes it to the TCP stack. It first gives other messages that
+        are about to be sent a chance to be written, so that they go out together. */
         pump_coro_t flusher;
 
+        /* The number of messages written since the last flush, and when the first of
+        them was written. Protected by `send_mutex`. */
+        int64_t unflushed_messages;
+        ticks_t first_unflushed_ticks;
+
         perfmon_collection_t pm_collection;
         perfmon_sampler_t pm_bytes_sent;
+        /* The size of compressed messages before and after compression. */
+        perfmon_counter_t pm_compression_bytes_in, pm_compression_bytes_out;
+        /* How many messages go out with each flush, and how long the first of them
+        waited for it. */
+        perfmon_sampler_t pm_messages_per_flush, pm_flush_latency;
         perfmon_membership_t pm_collection_membership, pm_bytes_sent_membership;
+        perfmon_multi_membership_t pm_compression_membership, pm_flush_membership;
 
         /* We only hold this information so we can deregister ourself */
         run_t *parent;
@@ -203,7 +238,8 @@ public:
                   heartbeat_semilattice_metadata_t> > heartbeat_sl_view,
               std::shared_ptr<semilattice_read_view_t<
                   auth_semilattice_metadata_t> > auth_sl_view,
-              tls_ctx_t *tls_ctx)
+              tls_ctx_t *tls_ctx,
+              bool compress_messages)
             THROWS_ONLY(address_in_use_exc_t, tcp_socket_exc_t);
 
         ~run_t();
@@ -298,6 +334,9 @@ public:
 
         tls_ctx_t *tls_ctx;
 
+        /* Whether we compress large messages to peers that support it. */
+        bool compress_messages;
+
         /* `attempt_table` is a table of all the host:port pairs we're currently
         trying to connect to or have connected to. If we are told to connect to
         an address already in this table, we'll just ignore it. That's important
@@ -389,6 +428,10 @@ private:
 
     cluster_message_handler_t *message_handlers[max_message_tag];
 
+    /* Buffers that `send_message()` can serialize messages into, so that it doesn't
+    have to allocate a new one for every message. */
+    one_per_thread_t<std::vector<std::vector<char> > > send_buffers;
+
 #ifdef ENABLE_MESSAGE_PROFILER
     /* The key is the string passed to `send_message()`. The value is a pair of (number
     of individual messages, total number of bytes). */
@@ -430,6 +473,12 @@ protected:
                             auto_drainer_t::lock_t keepalive,
                             read_stream_t *) = 0;
 
+    /* Whether large messages with this tag may be sent after smaller ones that were
+    sent later. */
+    virtual bool messages_may_be_reordered() const {
+        return false;
+    }
+
     /* The default implementation constructs a stream reading from `data` and then
     calls `on_message()`. Override to optimize for the local case. */
     virtual void on_local_message(connectivity_cluster_t::connection_t *conn,
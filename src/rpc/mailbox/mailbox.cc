@@ -181,7 +181,11 @@ void read_mailbox_header(read_stream_t *stream,
     }
     header_out->data_length = data_length;
     res = deserialize_universal(stream, &header_out->dest_thread);
-    if (bad(res)) { throw fake_archive_exc_t(); }
+    if (bad(res)
+        || header_out->dest_thread < 0
+        || header_out->dest_thread >= get_num_threads()) {
+        throw fake_archive_exc_t();
+    }
     res = deserialize_universal(stream, &header_out->dest_mailbox_id);
     if (bad(res)) { throw fake_archive_exc_t(); }
 }
@@ -206,15 +210,10 @@ void mailbox_manager_t::on_local_message(
         throw fake_archive_exc_t();
     }
 
-    // We use `spawn_now_dangerously()` to avoid having to heap-allocate `stream_data`.
-    // Instead we pass in a pointer to our local automatically allocated object
-    // and `mailbox_read_coroutine()` moves the data out of it before it yields.
-    coro_t::spawn_now_dangerously(
-        [this, mbox_header, &stream_data, stream_data_offset]() {
-            mailbox_read_coroutine(
-                threadnum_t(mbox_header.dest_thread), mbox_header.dest_mailbox_id,
-                &stream_data, stream_data_offset, FORCE_YIELD);
-        });
+    spawn_mailbox_read(threadnum_t(mbox_header.dest_thread),
+                       mbox_header.dest_mailbox_id,
+                       std::move(stream_data),
+                       stream_data_offset);
 }
 
 void mailbox_manager_t::on_message(
@@ -233,52 +232,51 @@ void mailbox_manager_t::on_message(
         throw fake_archive_exc_t();
     }
 
-    // We use `spawn_now_dangerously()` to avoid having to heap-allocate `stream_data`.
-    // Instead we pass in a pointer to our local automatically allocated object
-    // and `mailbox_read_coroutine()` moves the data out of it before it yields.
-    coro_t::spawn_now_dangerously(
-        [this, mbox_header, &stream_data]() {
-            mailbox_read_coroutine(
-                threadnum_t(mbox_header.dest_thread), mbox_header.dest_mailbox_id,
-                &stream_data, 0, MAYBE_YIELD);
-        });
+    spawn_mailbox_read(threadnum_t(mbox_header.dest_thread),
+                       mbox_header.dest_mailbox_id,
+                       std::move(stream_data),
+                       0);
 }
 
-void mailbox_manager_t::mailbox_read_coroutine(
+void mailbox_manager_t::spawn_mailbox_read(
         threadnum_t dest_thread,
         raw_mailbox_t::id_t dest_mailbox_id,
-        std::vector<char> *stream_data,
-        int64_t stream_data_offset,
-        force_yield_t force_yield) {
+        std::vector<char> &&stream_data,
+        int64_t stream_data_offset) {
+    // The coroutine starts out on the destination thread, rather than going there
+    // with an `on_thread_t` and then back to the connection's thread just to exit.
+    // Since it isn't run right away, we also don't have to worry about reentrancy
+    // in case of local delivery.
+    coro_t::spawn_on_thread(
+        std::bind(&mailbox_manager_t::mailbox_read_coroutine,
+                  this,
+                  dest_mailbox_id,
+                  std::move(stream_data),
+                  stream_data_offset),
+        dest_thread);
+}
 
+void mailbox_manager_t::mailbox_read_coroutine(
+        raw_mailbox_t::id_t dest_mailbox_id,
+        std::vector<char> &stream_data,
+        int64_t stream_data_offset) {
     // Construct a new stream to use
-    vector_read_stream_t stream(std::move(*stream_data), stream_data_offset);
-    stream_data = nullptr; // <- It is not safe to use `stream_data` anymore once we
-                        //    switch the thread
-
-    {
-        on_thread_t rethreader(dest_thread);
-        if (force_yield == FORCE_YIELD && rethreader.home_thread() == get_thread_id()) {
-            // Yield to avoid problems with reentrancy in case of local
-            // delivery.
-            coro_t::yield();
-        }
-
-        try {
-            raw_mailbox_t *mbox = mailbox_tables.get()->find_mailbox(dest_mailbox_id);
-            if (mbox != nullptr) {
-                try {
-                    auto_drainer_t::lock_t keepalive(&mbox->drainer);
-                    mbox->callback->read(&stream, keepalive.get_drain_signal());
-                } catch (const interrupted_exc_t &) {
-                    /* Do nothing. It's no longer safe to access `mbox` (because the
-                    destructor is running) but otherwise we don't need to take any
-                    special action. */
-                }
+    vector_read_stream_t stream(std::move(stream_data), stream_data_offset);
+
+    try {
+        raw_mailbox_t *mbox = mailbox_tables.get()->find_mailbox(dest_mailbox_id);
+        if (mbox != nullptr) {
+            try {
+                auto_drainer_t::lock_t keepalive(&mbox->drainer);
+                mbox->callback->read(&stream, keepalive.get_drain_signal());
+            } catch (const interrupted_exc_t &) {
+                /* Do nothing. It's no longer safe to access `mbox` (because the
+                destructor is running) but otherwise we don't need to take any
+                special action. */
             }
-        } catch (const fake_archive_exc_t &e) {
-            logWRN("Received an invalid cluster message from a peer.");
         }
+    } catch (const fake_archive_exc_t &e) {
+        logWRN("Received an invalid cluster message from a peer.");
     }
 }
 
@@ -177,12 +177,19 @@ private:
                           auto_drainer_t::lock_t connection_keepalive,
                           std::vector<char> &&data);
 
-    enum force_yield_t {FORCE_YIELD, MAYBE_YIELD};
-    void mailbox_read_coroutine(threadnum_t dest_thread,
-                                raw_mailbox_t::id_t dest_mailbox_id,
-                                std::vector<char> *stream_data,
-                                int64_t stream_data_offset,
-                                force_yield_t force_yield);
+    // Mailbox messages are not necessarily delivered in order anyway.
+    bool messages_may_be_reordered() const {
+        return true;
+    }
+
+    /* Spawns `mailbox_read_coroutine()` directly on `dest_thread`. */
+    void spawn_mailbox_read(threadnum_t dest_thread,
+                            raw_mailbox_t::id_t dest_mailbox_id,
+                            std::vector<char> &&stream_data,
+                            int64_t stream_data_offset);
+    void mailbox_read_coroutine(raw_mailbox_t::id_t dest_mailbox_id,
+                                std::vector<char> &stream_data,
+                                int64_t stream_data_offset);
 };
 
 /* Note: disconnect_watcher_t keeps the connection alive for as long as it
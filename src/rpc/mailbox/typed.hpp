@@ -30,6 +30,10 @@ public:
 private:
     template <class... Args2>
     friend void send(mailbox_manager_t *, mailbox_addr_t<Args2...>, const Args2 &... args);
+    template <class... Args2>
+    friend void send_with_writer(mailbox_manager_t *,
+                                 mailbox_addr_t<Args2...>,
+                                 mailbox_write_callback_t *);
 
     raw_mailbox_t::address_t addr;
 };
@@ -105,4 +109,14 @@ void send(mailbox_manager_t *src, mailbox_addr_t<Args...> dest, const Args &...
     send_write(src, dest.addr, &writer);
 }
 
+/* Like `send()`, except that the message is written by `writer`, which must produce
+the same bytes as serializing `Args...` would.  This lets the sender serialize a
+message that goes to many mailboxes only once. */
+template <class... Args>
+void send_with_writer(mailbox_manager_t *src,
+                      mailbox_addr_t<Args...> dest,
+                      mailbox_write_callback_t *writer) {
+    send_write(src, dest.addr, writer);
+}
+
 #endif // RPC_MAILBOX_TYPED_HPP_
@@ -4,6 +4,7 @@
 #include "unittest/gtest.hpp"
 
 #include "containers/archive/boost_types.hpp"
+#include "containers/archive/buffer_stream.hpp"
 #include "containers/archive/stl_types.hpp"
 
 namespace unittest {
@@ -34,6 +35,43 @@ TEST(WriteMessageTest, Variant) {
     ASSERT_EQ(15u, s.size());
 }
 
+TEST(WriteMessageTest, PrimitiveVector) {
+    // Large enough to span several write buffers.
+    std::vector<int32_t> v;
+    for (int32_t i = 0; i < 3000; ++i) {
+        v.push_back(i * 7919);
+    }
+
+    write_message_t wm;
+    serialize<cluster_version_t::LATEST_OVERALL>(&wm, v);
+    std::string s;
+    dump_to_string(&wm, &s);
+
+    // The elements are copied in bulk, but the result must be the same as if they
+    // had been serialized one by one.
+    write_message_t expected_wm;
+    serialize_varint_uint64(&expected_wm, v.size());
+    for (int32_t x : v) {
+        serialize<cluster_version_t::LATEST_OVERALL>(&expected_wm, x);
+    }
+    std::string expected;
+    dump_to_string(&expected_wm, &expected);
+    ASSERT_EQ(expected, s);
+    ASSERT_EQ(s.size(), serialized_size<cluster_version_t::LATEST_OVERALL>(v));
+
+    buffer_read_stream_t stream(s.data(), s.size());
+    std::vector<int32_t> out;
+    archive_result_t res
+        = deserialize<cluster_version_t::LATEST_OVERALL>(&stream, &out);
+    ASSERT_EQ(archive_result_t::SUCCESS, res);
+    ASSERT_EQ(v, out);
+
+    // A truncated message fails to deserialize.
+    buffer_read_stream_t short_stream(s.data(), s.size() - 1);
+    res = deserialize<cluster_version_t::LATEST_OVERALL>(&short_stream, &out);
+    ASSERT_EQ(archive_result_t::SOCK_EOF, res);
+}
+
 
 
 }  // namespace unittest
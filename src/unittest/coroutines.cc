@@ -3,6 +3,7 @@
 #include "arch/runtime/coroutines.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "concurrency/auto_drainer.hpp"
+#include "concurrency/pmap.hpp"
 #include "config/args.hpp"
 #include "unittest/gtest.hpp"
 #include "unittest/unittest_utils.hpp"
@@ -83,6 +84,78 @@ TEST(CoroutinesTest, OnThreadOrdering) {
     }, num_threads);
 }
 
+TEST(CoroutinesTest, CrossThreadPingPong) {
+    // Bounces coroutines between all pairs of threads at the same time, so that
+    // every thread receives messages from many senders at once.
+    int num_threads = 8;
+    int num_round_trips = 1000;
+    run_in_thread_pool([&]() {
+        auto_drainer_t drainer;
+        std::vector<int> arrivals(num_threads * num_threads, 0);
+        for (int from = 0; from < num_threads; ++from) {
+            for (int to = 0; to < num_threads; ++to) {
+                auto_drainer_t::lock_t lock(&drainer);
+                coro_t::spawn_sometime([&arrivals, from, to, num_threads,
+                                        num_round_trips, lock]() {
+                    threadnum_t home(from);
+                    threadnum_t away(to);
+                    on_thread_t start(home);
+                    for (int i = 0; i < num_round_trips; ++i) {
+                        {
+                            on_thread_t t(away);
+                            ASSERT_EQ(get_thread_id(), away);
+                            ++arrivals[from * num_threads + to];
+                        }
+                        ASSERT_EQ(get_thread_id(), home);
+                    }
+                });
+            }
+        }
+        drainer.drain();
+        for (int i = 0; i < num_threads * num_threads; ++i) {
+            ASSERT_EQ(num_round_trips, arrivals[i]);
+        }
+    }, num_threads);
+}
+
+TEST(CoroutinesTest, SmallStacks) {
+    run_in_thread_pool([&]() {
+        // Run more tasks than fit onto the free list, so that small coroutines
+        // are both allocated and reused.
+        int64_t num_tasks = 1000;
+        std::vector<int> ran(num_tasks, 0);
+        pmap(num_tasks, [&](int64_t i) {
+            ASSERT_TRUE(has_n_bytes_free_stack_space(1024));
+            // `pmap()` runs the last item on the calling coroutine.
+            if (i != num_tasks - 1) {
+                ASSERT_FALSE(
+                    has_n_bytes_free_stack_space(SMALL_COROUTINE_STACK_SIZE));
+            }
+            coro_t::yield();
+            ++ran[i];
+        }, coro_stack_size_t::SMALL);
+        for (int64_t i = 0; i < num_tasks; ++i) {
+            ASSERT_EQ(1, ran[i]);
+        }
+
+        // Coroutines spawned directly with a small stack.
+        cond_t small_done;
+        coro_t::spawn_sometime([&]() {
+            ASSERT_FALSE(has_n_bytes_free_stack_space(SMALL_COROUTINE_STACK_SIZE));
+            small_done.pulse();
+        }, coro_stack_size_t::SMALL);
+        small_done.wait_lazily_unordered();
+
+        // Normal coroutines still get a full stack after small ones were freed.
+        cond_t done;
+        coro_t::spawn_sometime([&]() {
+            ASSERT_TRUE(has_n_bytes_free_stack_space(SMALL_COROUTINE_STACK_SIZE));
+            done.pulse();
+        });
+        done.wait_lazily_unordered();
+    });
+}
+
 TEST(CoroutinesTest, NotifyNow) {
     // Test that `spawn_now_dangerously` doesn't block`
     run_in_thread_pool([&]() {
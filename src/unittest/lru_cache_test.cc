@@ -38,4 +38,25 @@ TEST(LRUCacheTest, Basic) {
     EXPECT_FALSE(res);
 }
 
+TEST(LRUCacheTest, EvictionCallback) {
+    lru_cache_t<std::string, std::string> cache(2);
+    std::vector<std::pair<std::string, std::string> > evicted;
+    auto on_evict = [&](const std::string &key, std::string &&value) {
+        evicted.push_back(std::make_pair(key, std::move(value)));
+    };
+    EXPECT_TRUE(cache.insert("1", "one", on_evict));
+    EXPECT_TRUE(cache.insert("2", "two", on_evict));
+    EXPECT_TRUE(evicted.empty());
+    std::string *p;
+    ASSERT_TRUE(cache.lookup("1", &p));
+    // Usage ordering is now 2 1, so inserting "3" evicts "2".
+    EXPECT_TRUE(cache.insert("3", "three", on_evict));
+    ASSERT_EQ(1, evicted.size());
+    EXPECT_EQ("2", evicted[0].first);
+    EXPECT_EQ("two", evicted[0].second);
+    // A failed insertion doesn't evict anything.
+    EXPECT_FALSE(cache.insert("1", "uno", on_evict));
+    EXPECT_EQ(1, evicted.size());
+}
+
 } // namespace unittest
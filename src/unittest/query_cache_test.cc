@@ -0,0 +1,239 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include "concurrency/cond_var.hpp"
+#include "rapidjson/document.h"
+#include "rdb_protocol/pseudo_time.hpp"
+#include "rdb_protocol/ql2proto.hpp"
+#include "rdb_protocol/query_cache.hpp"
+#include "rdb_protocol/query_params.hpp"
+#include "rdb_protocol/rdb_backtrace.hpp"
+#include "rdb_protocol/response.hpp"
+#include "rdb_protocol/term_storage.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/rdb_env.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// Sends JSON queries to a `query_cache_t` the way `rdb_query_server_t` does, but
+// without a connection.
+class query_cache_client_t {
+public:
+    explicit query_cache_client_t(test_rdb_env_t::instance_t *env_instance)
+        : cache(env_instance->get_rdb_context(),
+                ip_and_port_t(ip_address_t("127.0.0.1"), port_t(0)),
+                ql::return_empty_normal_batches_t::NO,
+                auth::user_context_t(auth::username_t("admin"))),
+          next_token(1) { }
+
+    void run(const std::string &query_json, ql::response_t *res) {
+        scoped_array_t<char> buffer(query_json.size() + 1);
+        memcpy(buffer.data(), query_json.data(), query_json.size());
+        buffer[query_json.size()] = '\0';
+        rapidjson::Document doc;
+        doc.ParseInsitu(buffer.data());
+        guarantee(!doc.HasParseError());
+
+        res->clear();
+        try {
+            ql::query_params_t query_params(
+                next_token++, &cache,
+                scoped_ptr_t<ql::term_storage_t>(
+                    new ql::json_term_storage_t(std::move(buffer), std::move(doc))));
+            if (query_params.type == Query::PREPARE) {
+                int64_t plan_id = cache.prepare(&query_params);
+                res->set_type(Response::SUCCESS_ATOM);
+                res->set_data(ql::datum_t(static_cast<double>(plan_id)));
+            } else {
+                guarantee(query_params.type == Query::START
+                          || query_params.type == Query::EXECUTE);
+                cond_t interruptor;
+                scoped_ptr_t<ql::query_cache_t::ref_t> query_ref =
+                    cache.create(&query_params, ql::pseudo::time_now(), &interruptor);
+                query_ref->fill_response(res);
+            }
+        } catch (const ql::bt_exc_t &ex) {
+            res->fill_error(ex.response_type, ex.error_type, ex.message, ex.bt_datum);
+        }
+    }
+
+    int64_t prepare(const std::string &term_json) {
+        ql::response_t res;
+        run(strprintf("[%d,%s,{}]",
+                      static_cast<int>(Query::PREPARE),
+                      term_json.c_str()),
+            &res);
+        guarantee(res.type() == Response::SUCCESS_ATOM);
+        return res.data()[0].as_int();
+    }
+
+    // `args_json` is the part of the body after the plan id, including a leading
+    // comma if there are any arguments.
+    void execute(int64_t plan_id,
+                 const std::string &args_json,
+                 const std::string &optargs_json,
+                 ql::response_t *res) {
+        run(strprintf("[%d,[%" PRIi64 "%s],%s]",
+                      static_cast<int>(Query::EXECUTE),
+                      plan_id,
+                      args_json.c_str(),
+                      optargs_json.c_str()),
+            res);
+    }
+
+private:
+    ql::query_cache_t cache;
+    int64_t next_token;
+};
+
+// `function(x) { return x.add(1); }`
+const char *add_one_json = "[69,[[2,[1]],[24,[[10,[1]],1]]]]";
+// `function(x) { return r.range(x).coerceTo('array'); }`
+const char *range_array_json = "[69,[[2,[1]],[51,[[173,[[10,[1]]]],\"array\"]]]]";
+
+void run_execute_prepared_test(test_rdb_env_t *test_env) {
+    scoped_ptr_t<test_rdb_env_t::instance_t> env_instance = test_env->make_env();
+    query_cache_client_t client(env_instance.get());
+
+    int64_t plan_id = client.prepare(add_one_json);
+    // Preparing the same term again reuses the plan.
+    ASSERT_EQ(plan_id, client.prepare(add_one_json));
+
+    ql::response_t res;
+    client.execute(plan_id, ",41", "{}", &res);
+    ASSERT_EQ(Response::SUCCESS_ATOM, res.type());
+    ASSERT_EQ(ql::datum_t(42.0), res.data()[0]);
+
+    client.execute(plan_id, ",1", "{}", &res);
+    ASSERT_EQ(Response::SUCCESS_ATOM, res.type());
+    ASSERT_EQ(ql::datum_t(2.0), res.data()[0]);
+
+    // A prepared function must be called with the right number of arguments.
+    client.execute(plan_id, "", "{}", &res);
+    ASSERT_EQ(Response::RUNTIME_ERROR, res.type());
+}
+
+TEST(QueryCache, ExecutePrepared) {
+    test_rdb_env_t test_env;
+    test_env.add_database("test");
+    run_in_thread_pool(std::bind(run_execute_prepared_test, &test_env));
+}
+
+void run_execute_optargs_test(test_rdb_env_t *test_env) {
+    scoped_ptr_t<test_rdb_env_t::instance_t> env_instance = test_env->make_env();
+    query_cache_client_t client(env_instance.get());
+
+    int64_t plan_id = client.prepare(range_array_json);
+
+    ql::response_t res;
+    client.execute(plan_id, ",3", "{}", &res);
+    ASSERT_EQ(Response::SUCCESS_ATOM, res.type());
+    ASSERT_EQ(3u, res.data()[0].arr_size());
+
+    // The optargs of each `EXECUTE` apply to that query only.
+    client.execute(plan_id, ",3", "{\"array_limit\":2}", &res);
+    ASSERT_EQ(Response::RUNTIME_ERROR, res.type());
+    ASSERT_EQ(Response::RESOURCE_LIMIT, *res.error_type());
+
+    client.execute(plan_id, ",3", "{\"array_limit\":3}", &res);
+    ASSERT_EQ(Response::SUCCESS_ATOM, res.type());
+    ASSERT_EQ(3u, res.data()[0].arr_size());
+
+    // Errors in the optargs aren't resolved against the plan's backtraces.
+    client.execute(plan_id, ",3", "{\"array_limit\":0}", &res);
+    ASSERT_EQ(Response::RUNTIME_ERROR, res.type());
+    ASSERT_TRUE(res.backtrace().has_value());
+    ASSERT_EQ(ql::backtrace_registry_t::EMPTY_BACKTRACE, *res.backtrace());
+}
+
+TEST(QueryCache, ExecuteOptargs) {
+    test_rdb_env_t test_env;
+    test_env.add_database("test");
+    run_in_thread_pool(std::bind(run_execute_optargs_test, &test_env));
+}
+
+void run_execute_unknown_test(test_rdb_env_t *test_env) {
+    scoped_ptr_t<test_rdb_env_t::instance_t> env_instance = test_env->make_env();
+    query_cache_client_t client(env_instance.get());
+
+    ql::response_t res;
+    client.execute(12345, "", "{}", &res);
+    ASSERT_EQ(Response::CLIENT_ERROR, res.type());
+    ASSERT_EQ("Prepared query 12345 not in plan cache.",
+              res.data()[0].as_str().to_std());
+}
+
+TEST(QueryCache, ExecuteUnknown) {
+    test_rdb_env_t test_env;
+    test_env.add_database("test");
+    run_in_thread_pool(std::bind(run_execute_unknown_test, &test_env));
+}
+
+void run_compile_errors_test(test_rdb_env_t *test_env) {
+    scoped_ptr_t<test_rdb_env_t::instance_t> env_instance = test_env->make_env();
+    query_cache_client_t client(env_instance.get());
+
+    // Malformed terms are rejected while preprocessing them, whether the query is
+    // sent directly or prepared.
+    ql::response_t res;
+    client.run(strprintf("[%d,[999999],{}]", static_cast<int>(Query::START)), &res);
+    ASSERT_EQ(Response::COMPILE_ERROR, res.type());
+    ASSERT_EQ("Unrecognized TermType: 999999.", res.data()[0].as_str().to_std());
+
+    client.run(strprintf("[%d,[999999],{}]", static_cast<int>(Query::PREPARE)), &res);
+    ASSERT_EQ(Response::COMPILE_ERROR, res.type());
+    ASSERT_EQ("Unrecognized TermType: 999999.", res.data()[0].as_str().to_std());
+
+    // Bad arguments to a prepared query are reported the same way.
+    int64_t plan_id = client.prepare(add_one_json);
+    client.execute(plan_id, ",{\"$reql_type$\":\"BOGUS\"}", "{}", &res);
+    ASSERT_EQ(Response::COMPILE_ERROR, res.type());
+    ASSERT_EQ("Unknown $reql_type$ `PTYPE<BOGUS>`.", res.data()[0].as_str().to_std());
+}
+
+TEST(QueryCache, CompileErrors) {
+    test_rdb_env_t test_env;
+    test_env.add_database("test");
+    run_in_thread_pool(std::bind(run_compile_errors_test, &test_env));
+}
+
+void run_eviction_test(test_rdb_env_t *test_env) {
+    scoped_ptr_t<test_rdb_env_t::instance_t> env_instance = test_env->make_env();
+    query_cache_client_t client(env_instance.get());
+
+    // `i.add(1)` for different `i`, so that each term has its own plan.
+    auto term_json = [](size_t i) {
+        return strprintf("[24,[%zu,1]]", i);
+    };
+    std::vector<int64_t> plan_ids;
+    for (size_t i = 0; i <= ql::query_cache_t::MAX_PREPARED_QUERIES; ++i) {
+        plan_ids.push_back(client.prepare(term_json(i)));
+    }
+
+    // The least recently used plan was evicted.
+    ql::response_t res;
+    client.execute(plan_ids[0], "", "{}", &res);
+    ASSERT_EQ(Response::CLIENT_ERROR, res.type());
+
+    for (size_t i = 1; i < plan_ids.size(); ++i) {
+        client.execute(plan_ids[i], "", "{}", &res);
+        ASSERT_EQ(Response::SUCCESS_ATOM, res.type());
+        ASSERT_EQ(ql::datum_t(static_cast<double>(i + 1)), res.data()[0]);
+    }
+
+    // Preparing an evicted term again compiles a new plan.
+    int64_t new_plan_id = client.prepare(term_json(0));
+    ASSERT_NE(plan_ids[0], new_plan_id);
+    client.execute(new_plan_id, "", "{}", &res);
+    ASSERT_EQ(Response::SUCCESS_ATOM, res.type());
+    ASSERT_EQ(ql::datum_t(1.0), res.data()[0]);
+}
+
+TEST(QueryCache, Eviction) {
+    test_rdb_env_t test_env;
+    test_env.add_database("test");
+    run_in_thread_pool(std::bind(run_eviction_test, &test_env));
+}
+
+}  // namespace unittest
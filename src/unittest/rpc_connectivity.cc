@@ -11,6 +11,7 @@
 #include "arch/timing.hpp"
 #include "containers/scoped.hpp"
 #include "containers/archive/socket_stream.hpp"
+#include "rdb_protocol/datum.hpp"
 #include "unittest/clustering_utils.hpp"
 #include "unittest/unittest_utils.hpp"
 #include "rpc/connectivity/cluster.hpp"
@@ -391,29 +392,35 @@ TPTEST(RPCConnectivityTest, Multiplexer) {
 
 class binary_test_application_t : public cluster_message_handler_t {
 public:
-    explicit binary_test_application_t(connectivity_cluster_t *cm) :
+    // The message consists of `_repeats` copies of the spectrum.
+    explicit binary_test_application_t(connectivity_cluster_t *cm, int _repeats = 1) :
         cluster_message_handler_t(cm, 'B'),
-        got_spectrum(false)
+        got_spectrum(false),
+        repeats(_repeats)
         { }
     void send_spectrum(peer_id_t peer) {
         class dump_spectrum_writer_t :
             public cluster_send_message_write_callback_t {
         public:
+            explicit dump_spectrum_writer_t(int _repeats) : repeats(_repeats) { }
             virtual ~dump_spectrum_writer_t() { }
             void write(write_stream_t *stream) {
                 char spectrum[CHAR_MAX - CHAR_MIN + 1];
                 for (int i = CHAR_MIN; i <= CHAR_MAX; i++) {
                     spectrum[i - CHAR_MIN] = i;
                 }
-                int64_t res = stream->write(spectrum, CHAR_MAX - CHAR_MIN + 1);
-                if (res != CHAR_MAX - CHAR_MIN + 1) { throw fake_archive_exc_t(); }
+                for (int r = 0; r < repeats; ++r) {
+                    int64_t res = stream->write(spectrum, CHAR_MAX - CHAR_MIN + 1);
+                    if (res != CHAR_MAX - CHAR_MIN + 1) { throw fake_archive_exc_t(); }
+                }
             }
 #ifdef ENABLE_MESSAGE_PROFILER
             const char *message_profiler_tag() const {
                 return "unittest";
             }
 #endif
-        } writer;
+            int repeats;
+        } writer(repeats);
         auto_drainer_t::lock_t connection_keepalive;
         connectivity_cluster_t::connection_t *connection =
             get_connectivity_cluster()->get_connection(peer, &connection_keepalive);
@@ -424,16 +431,19 @@ public:
     void on_message(connectivity_cluster_t::connection_t *,
                     auto_drainer_t::lock_t,
                     read_stream_t *stream) {
-        char spectrum[CHAR_MAX - CHAR_MIN + 1];
-        int64_t res = force_read(stream, spectrum, CHAR_MAX - CHAR_MIN + 1);
-        if (res != CHAR_MAX - CHAR_MIN + 1) { throw fake_archive_exc_t(); }
+        for (int r = 0; r < repeats; ++r) {
+            char spectrum[CHAR_MAX - CHAR_MIN + 1];
+            int64_t res = force_read(stream, spectrum, CHAR_MAX - CHAR_MIN + 1);
+            if (res != CHAR_MAX - CHAR_MIN + 1) { throw fake_archive_exc_t(); }
 
-        for (int i = CHAR_MIN; i <= CHAR_MAX; i++) {
-            EXPECT_EQ(spectrum[i - CHAR_MIN], i);
+            for (int i = CHAR_MIN; i <= CHAR_MAX; i++) {
+                EXPECT_EQ(spectrum[i - CHAR_MIN], i);
+            }
         }
         got_spectrum = true;
     }
     bool got_spectrum;
+    int repeats;
 };
 
 TPTEST_MULTITHREAD(RPCConnectivityTest, BinaryData, 3) {
@@ -452,6 +462,37 @@ TPTEST_MULTITHREAD(RPCConnectivityTest, BinaryData, 3) {
     EXPECT_TRUE(a2.got_spectrum);
 }
 
+/* `CompressedData` is like `BinaryData`, but with a message that's large enough to be
+compressed. */
+TPTEST_MULTITHREAD(RPCConnectivityTest, CompressedData, 3) {
+    connectivity_cluster_t c1, c2;
+    binary_test_application_t a1(&c1, 64), a2(&c2, 64);
+    test_cluster_run_t cr1(&c1, peer_address_t(), true);
+    test_cluster_run_t cr2(&c2, peer_address_t(), true);
+    cr1.join(get_cluster_local_address(&c2), 0);
+
+    let_stuff_happen();
+
+    a1.send_spectrum(c2.get_me());
+
+    let_stuff_happen();
+
+    EXPECT_TRUE(a2.got_spectrum);
+
+    // The message must actually have been compressed on the way.
+    auto_drainer_t::lock_t connection_keepalive;
+    connectivity_cluster_t::connection_t *connection =
+        c1.get_connection(c2.get_me(), &connection_keepalive);
+    ASSERT_TRUE(connection != nullptr);
+    EXPECT_TRUE(connection->compresses_messages());
+    ql::datum_t stats = connection->get_stats();
+    int64_t bytes_in = stats.get_field("compression_bytes_in").as_int();
+    int64_t bytes_out = stats.get_field("compression_bytes_out").as_int();
+    EXPECT_GT(bytes_in, 0);
+    EXPECT_GT(bytes_out, 0);
+    EXPECT_LT(bytes_out, bytes_in);
+}
+
 /* `PeerIDSemantics` makes sure that `peer_id_t::is_nil()` works as expected. */
 TPTEST_MULTITHREAD(RPCConnectivityTest, PeerIDSemantics, 3) {
     peer_id_t nil_peer;
@@ -0,0 +1,61 @@
+// Copyright 2010-2016 RethinkDB, all rights reserved.
+#include <atomic>
+#include <stdexcept>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/run_anywhere.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TPTEST(RunAnywhereTest, RunsOnce, 4) {
+    const int num_threads = get_num_db_threads();
+    for (int first = 0; first < num_threads; ++first) {
+        int runs = 0;
+        threadnum_t ran_on = run_anywhere([&]() {
+            // `run_anywhere()` waits for us, so this doesn't race with the check.
+            ++runs;
+        }, threadnum_t(first), 2);
+        EXPECT_EQ(1, runs);
+        EXPECT_TRUE(ran_on.threadnum == first
+                    || ran_on.threadnum == (first + 1) % num_threads);
+    }
+}
+
+TPTEST(RunAnywhereTest, SkipsBusyThread, 4) {
+    ASSERT_LE(3, get_num_db_threads());
+    std::atomic<bool> spinning(false);
+    std::atomic<bool> job_done(false);
+    std::atomic<bool> spinner_done(false);
+    // Keep thread 1 busy until the job has run, without ever yielding.  If the job
+    // was run on thread 1 it would never finish.
+    coro_t::spawn_on_thread([&]() {
+        spinning.store(true);
+        while (!job_done.load()) { }
+        spinner_done.store(true);
+    }, threadnum_t(1));
+    while (!spinning.load()) {
+        nap(1);
+    }
+
+    threadnum_t ran_on = run_anywhere([&]() {
+        job_done.store(true);
+    }, threadnum_t(1), 2);
+    EXPECT_EQ(2, ran_on.threadnum);
+
+    while (!spinner_done.load()) {
+        nap(1);
+    }
+    // Let thread 1 get back to its event loop before the thread pool shuts down.
+    on_thread_t rethreader((threadnum_t(1)));
+}
+
+TPTEST(RunAnywhereTest, RethrowsExceptions, 4) {
+    EXPECT_THROW(run_anywhere([]() {
+        throw std::runtime_error("error in job");
+    }, threadnum_t(1)), std::runtime_error);
+}
+
+}  // namespace unittest